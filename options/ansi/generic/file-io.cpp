@@ -1,5 +1,6 @@
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -13,11 +14,80 @@
 #include <abi-bits/abi.h>
 #include <frg/allocation.hpp>
 #include <mlibc/allocator.hpp>
+#include <mlibc/arch-defs.hpp>
 #include <mlibc/file-io.hpp>
 #include <mlibc/sysdeps.hpp>
+#include <internal-config.h>
 
 namespace mlibc {
 
+// --------------------------------------------------------------------------------------
+// file_allocator implementation.
+// --------------------------------------------------------------------------------------
+
+namespace {
+	// Blocks of up to 64 KiB are cached; larger blocks are returned to the allocator immediately.
+	constexpr int numSizeClasses = 11;
+	constexpr size_t minClassSize = 64;
+	constexpr int slotsPerClass = 8;
+
+	// Each block is preceded by a header that stores its size class (or -1).
+	// The header size preserves the alignment of the underlying allocator.
+	constexpr size_t blockHeaderSize = 16;
+
+	// Slots are claimed and released by atomic exchanges on a single pointer;
+	// hence, the cache is lock-free and not susceptible to ABA problems.
+	void *cachedBlocks[numSizeClasses][slotsPerClass];
+
+	file_allocator fileAllocator;
+}
+
+void *file_allocator::allocate(size_t size) {
+	int size_class = 0;
+	while(size_class < numSizeClasses && (minClassSize << size_class) < size)
+		size_class++;
+
+	size_t block_size = size;
+	if(size_class < numSizeClasses) {
+		for(auto &slot : cachedBlocks[size_class]) {
+			if(!__atomic_load_n(&slot, __ATOMIC_RELAXED))
+				continue;
+			auto block = __atomic_exchange_n(&slot, nullptr, __ATOMIC_ACQUIRE);
+			if(block)
+				return reinterpret_cast<char *>(block) + blockHeaderSize;
+		}
+		block_size = minClassSize << size_class;
+	}else{
+		size_class = -1;
+	}
+
+	auto block = reinterpret_cast<char *>(getAllocator().allocate(blockHeaderSize + block_size));
+	if(!block)
+		return nullptr;
+	*reinterpret_cast<int *>(block) = size_class;
+	return block + blockHeaderSize;
+}
+
+void file_allocator::free(void *pointer) {
+	if(!pointer)
+		return;
+	auto block = reinterpret_cast<char *>(pointer) - blockHeaderSize;
+	auto size_class = *reinterpret_cast<int *>(block);
+	if(size_class >= 0) {
+		for(auto &slot : cachedBlocks[size_class]) {
+			void *expected = nullptr;
+			if(__atomic_compare_exchange_n(&slot, &expected, block, false,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+				return;
+		}
+	}
+	getAllocator().free(block);
+}
+
+file_allocator &getFileAllocator() {
+	return fileAllocator;
+}
+
 // --------------------------------------------------------------------------------------
 // abstract_file implementation.
 // --------------------------------------------------------------------------------------
@@ -35,6 +105,12 @@ namespace {
 	// Useful when debugging the FILE implementation.
 	constexpr bool globallyDisableBuffering = false;
 
+	// Parameters of the access pattern detection.
+	constexpr size_t defaultBufferSize = 128;
+	constexpr size_t maxBufferSize = 64 * 1024;
+	constexpr int sequentialRefillThreshold = 4;
+	constexpr int randomSeekThreshold = 4;
+
 	// List of files that will be flushed before exit().
 	file_list global_file_list;
 }
@@ -46,10 +122,13 @@ namespace {
 //     open (e.g. for std{in,out,err}), we defer the type determination and cache the result.
 
 abstract_file::abstract_file(void (*do_dispose)(abstract_file *))
-: _type{stream_type::unknown}, _bufmode{buffer_mode::unknown}, _do_dispose{do_dispose} {
+: _type{stream_type::unknown}, _bufmode{buffer_mode::unknown}, _do_dispose{do_dispose},
+		_io_position{0}, _io_position_known{false}, _pushed_back{false},
+		_sequential_refills{0}, _random_seeks{0}, _advice{POSIX_FADV_NORMAL},
+		_preferred_buffer_size{defaultBufferSize}, _orientation{0}, _stats{} {
 	// TODO: For __fwriting to work correctly, set the __io_mode to 1 if the write is write-only.
 	__buffer_ptr = nullptr;
-	__buffer_size = 128;
+	__buffer_size = defaultBufferSize;
 	__offset = 0;
 	__io_offset = 0;
 	__valid_limit = 0;
@@ -67,12 +146,16 @@ abstract_file::~abstract_file() {
 				<< frg::endlog;
 
 	if(__buffer_ptr)
-		getAllocator().free(__buffer_ptr);
+		getFileAllocator().free(__buffer_ptr);
 
 	auto it = global_file_list.iterator_to(this);
 	global_file_list.erase(it);
 }
 
+int abstract_file::fd() {
+	return -1;
+}
+
 void abstract_file::dispose() {
 	if(!_do_dispose)
 		return;
@@ -86,23 +169,42 @@ void abstract_file::dispose() {
 int abstract_file::read(char *buffer, size_t max_size, size_t *actual_size) {
 	__ensure(max_size);
 
+	// Byte I/O orients the stream (wide functions orient it before calling us).
+	if(!_orientation)
+		_orientation = -1;
+
 	if(_init_bufmode())
 		return -1;
 	if(globallyDisableBuffering || _bufmode == buffer_mode::no_buffer) {
+		// Even unbuffered streams keep the characters that were pushed back by unget().
+		if(__offset < __valid_limit) {
+			auto chunk = frg::min(size_t(__valid_limit - __offset), max_size);
+			memcpy(buffer, __buffer_ptr + __offset, chunk);
+			__offset += chunk;
+			*actual_size = chunk;
+			return 0;
+		}
+
 		size_t io_size;
+		_stats.reads++;
 		if(int e = io_read(buffer, max_size, &io_size); e) {
 			__status_bits |= __MLIBC_ERROR_BIT;
 			return e;
 		}
 		if(!io_size)
 			__status_bits |= __MLIBC_EOF_BIT;
+		_stats.bytes_read += io_size;
+		_io_position += io_size;
 		*actual_size = io_size;
 		return 0;
 	}
 
+	if(int e = _init_type(); e)
+		return e;
+
 	// Ensure correct buffer type for pipe-like streams.
 	// TODO: In order to support pipe-like streams we need to write-back the buffer.
-	if(__io_mode && __valid_limit)
+	if(_type == stream_type::pipe_like && __io_mode && __valid_limit)
 		mlibc::panicLogger() << "mlibc: Cannot read-write to same pipe-like stream"
 				<< frg::endlog;
 	__io_mode = 0;
@@ -116,12 +218,15 @@ int abstract_file::read(char *buffer, size_t max_size, size_t *actual_size) {
 			return e;
 
 		// Perform a read-ahead.
-		_ensure_allocation();
+		_note_refill();
 		size_t io_size;
-		if(int e = io_read(__buffer_ptr, __buffer_size, &io_size); e) {
+		_stats.refills++;
+		_stats.reads++;
+		if(int e = io_fill_buffer(&io_size); e) {
 			__status_bits |= __MLIBC_ERROR_BIT;
 			return e;
 		}
+		_stats.bytes_read += io_size;
 		if(!io_size) {
 			__status_bits |= __MLIBC_EOF_BIT;
 			*actual_size = 0;
@@ -130,6 +235,7 @@ int abstract_file::read(char *buffer, size_t max_size, size_t *actual_size) {
 
 		__io_offset = io_size;
 		__valid_limit = io_size;
+		_io_position += io_size;
 	}
 
 	// Return data from the buffer.
@@ -146,21 +252,29 @@ int abstract_file::read(char *buffer, size_t max_size, size_t *actual_size) {
 int abstract_file::write(const char *buffer, size_t max_size, size_t *actual_size) {
 	__ensure(max_size);
 
+	if(!_orientation)
+		_orientation = -1;
+
 	if(_init_bufmode())
 		return -1;
 	if(globallyDisableBuffering || _bufmode == buffer_mode::no_buffer) {
 		// As we do not buffer, nothing can be dirty.
 		__ensure(__dirty_begin == __dirty_end);
 		size_t io_size;
-		if(int e = io_write(buffer, max_size, &io_size); e) {
+		if(int e = _counted_io_write(buffer, max_size, &io_size); e) {
 			__status_bits |= __MLIBC_ERROR_BIT;
 			return e;
 		}
 		__ensure(io_size > 0 && "io_write() is expected to always write at least one byte");
+		// We cannot know whether the write appended to the file or not.
+		_io_position_known = false;
 		*actual_size = io_size;
 		return 0;
 	}
 
+	if(int e = _init_type(); e)
+		return e;
+
 	// Flush the buffer if necessary.
 	if(__offset == __buffer_size) {
 		if(int e = _write_back(); e)
@@ -173,7 +287,7 @@ int abstract_file::write(const char *buffer, size_t max_size, size_t *actual_siz
 	// TODO: We could full support pipe-like files
 	// by ungetc()ing all data before a write happens,
 	// however, for now we just report an error.
-	if(!__io_mode && __valid_limit) // TODO: Only check this for pipe-like streams.
+	if(_type == stream_type::pipe_like && !__io_mode && __valid_limit)
 		mlibc::panicLogger() << "mlibc: Cannot read-write to same pipe-like stream"
 				<< frg::endlog;
 	__io_mode = 1;
@@ -193,6 +307,8 @@ int abstract_file::write(const char *buffer, size_t max_size, size_t *actual_siz
 	__ensure(chunk);
 
 	// Buffer data (without necessarily performing I/O).
+	if(int e = io_unshare_buffer(); e)
+		return e;
 	_ensure_allocation();
 	memcpy(__buffer_ptr + __offset, buffer, chunk);
 
@@ -216,10 +332,39 @@ int abstract_file::write(const char *buffer, size_t max_size, size_t *actual_siz
 	return 0;
 }
 
-void abstract_file::unget(char c) {
-	__ensure(__offset);
+int abstract_file::unget(char c) {
+	// If we are at the start of the buffer, make room for the character.
+	// This also happens for unbuffered streams.
+	if(!__offset) {
+		if(int e = io_unshare_buffer(); e)
+			return e;
+		_ensure_allocation();
+		if(__valid_limit == __buffer_size)
+			return EAGAIN;
+		memmove(__buffer_ptr + 1, __buffer_ptr, __valid_limit);
+		__valid_limit++;
+		__io_offset++;
+		if(__dirty_begin != __dirty_end) {
+			__dirty_begin++;
+			__dirty_end++;
+		}
+		__offset++;
+		_pushed_back = true;
+	}else if(__buffer_ptr[__offset - 1] != c) {
+		if(int e = io_unshare_buffer(); e)
+			return e;
+		_pushed_back = true;
+	}
+
 	__offset--;
 	__buffer_ptr[__offset] = c;
+	return 0;
+}
+
+int abstract_file::orient(int mode) {
+	if(!_orientation && mode)
+		_orientation = mode > 0 ? 1 : -1;
+	return _orientation;
 }
 
 int abstract_file::update_bufmode(buffer_mode mode) {
@@ -235,48 +380,140 @@ void abstract_file::purge() {
 	__io_offset = 0;
 	__valid_limit = 0;
 	__dirty_end = __dirty_begin;
+	_pushed_back = false;
 }
 
 // TODO: For input files, discard the buffer.
 int abstract_file::flush() {
-	return _write_back();
+	if(int e = _write_back(); e)
+		return e;
+	if(int e = io_drain(); e) {
+		__status_bits |= __MLIBC_ERROR_BIT;
+		return e;
+	}
+	return 0;
 }
 
 int abstract_file::tell(off_t *current_offset) {
-	off_t seek_offset;
-	if(int e = io_seek(0, SEEK_CUR, &seek_offset); e)
-		return e;
+	if(!_io_position_known) {
+		if(int e = _counted_io_seek(0, SEEK_CUR, &_io_position); e)
+			return e;
+		_io_position_known = true;
+	}
 
-	*current_offset = seek_offset + (off_t(__offset) - off_t(__io_offset));
+	*current_offset = _io_position + (off_t(__offset) - off_t(__io_offset));
 	return 0;
 }
 
 int abstract_file::seek(off_t offset, int whence) {
+	if(int e = _init_type(); e)
+		return e;
+
+	// If the seek lands inside the buffer, we only need to adjust our offset.
+	// Note that SEEK_END would require us to know the size of the file.
+	// Seeks discard pushed back characters, hence, we cannot keep a buffer that contains them.
+	if(_type == stream_type::file_like && whence != SEEK_END && !_pushed_back) {
+		off_t buffer_offset = -1;
+		if(whence == SEEK_CUR) {
+			buffer_offset = off_t(__offset) + offset;
+		}else if(_io_position_known) {
+			__ensure(whence == SEEK_SET);
+			buffer_offset = offset - (_io_position - off_t(__io_offset));
+		}
+
+		if(buffer_offset >= 0 && buffer_offset <= off_t(__valid_limit)) {
+			__offset = buffer_offset;
+			__status_bits &= ~__MLIBC_EOF_BIT;
+			return 0;
+		}
+	}
+
 	if(int e = _write_back(); e)
 		return e;
 
+	// Position that the next read would have started at.
+	off_t old_position = -1;
+	if(_io_position_known)
+		old_position = _io_position - off_t(__io_offset) + off_t(__offset);
+
 	off_t new_offset;
 	if(whence == SEEK_CUR) {
 		auto seek_offset = offset + (off_t(__offset) - off_t(__io_offset));
-		if(int e = io_seek(seek_offset, whence, &new_offset); e) {
+		if(int e = _counted_io_seek(seek_offset, whence, &new_offset); e) {
 			__status_bits |= __MLIBC_ERROR_BIT;
 			return e;
 		}
 	}else{
 		__ensure(whence == SEEK_SET || whence == SEEK_END);
-		if(int e = io_seek(offset, whence, &new_offset); e) {
+		if(int e = _counted_io_seek(offset, whence, &new_offset); e) {
 			__status_bits |= __MLIBC_ERROR_BIT;
 			return e;
 		}
 	}
+	_io_position = new_offset;
+	_io_position_known = true;
+	if(_type == stream_type::file_like && new_offset != old_position)
+		_note_random_seek();
 
 	// We just forget the current buffer.
-	// TODO: If the seek is "small", we can just modify our internal offset.
 	purge();
+	__status_bits &= ~__MLIBC_EOF_BIT;
 
 	return 0;
 }
 
+int abstract_file::io_fill_buffer(size_t *actual_size) {
+	// The buffer is empty, so this is a good time to adapt its size.
+	if(__buffer_size != _preferred_buffer_size) {
+		__ensure(__dirty_begin == __dirty_end);
+		__ensure(!__valid_limit);
+		if(__buffer_ptr)
+			getFileAllocator().free(__buffer_ptr);
+		__buffer_ptr = nullptr;
+		__buffer_size = _preferred_buffer_size;
+	}
+
+	_ensure_allocation();
+	return io_read(__buffer_ptr, __buffer_size, actual_size);
+}
+
+int abstract_file::io_advise(int) {
+	return 0;
+}
+
+int abstract_file::_counted_io_write(const char *buffer, size_t max_size, size_t *actual_size) {
+	_stats.writes++;
+	if(int e = io_write(buffer, max_size, actual_size); e)
+		return e;
+	_stats.bytes_written += *actual_size;
+	if(*actual_size < max_size)
+		_stats.partial_writes++;
+	return 0;
+}
+
+int abstract_file::_counted_io_seek(off_t offset, int whence, off_t *new_offset) {
+	_stats.seeks++;
+	return io_seek(offset, whence, new_offset);
+}
+
+int abstract_file::io_drain() {
+	return 0;
+}
+
+int abstract_file::io_unshare_buffer() {
+	return 0;
+}
+
+bool abstract_file::writes_append() {
+	return false;
+}
+
+void abstract_file::_set_buffer_size(size_t size) {
+	__ensure(!__buffer_ptr);
+	__buffer_size = size;
+	_preferred_buffer_size = size;
+}
+
 int abstract_file::_init_type() {
 	if(_type != stream_type::unknown)
 		return 0;
@@ -303,14 +540,18 @@ int abstract_file::_write_back() {
 
 	if(__dirty_begin == __dirty_end)
 		return 0;
+	_stats.write_backs++;
 
 	// For non-pipe streams, first do a seek to reset the
 	// I/O position to zero, then do a write().
 	if(_type == stream_type::file_like) {
 		off_t new_offset;
-		if(int e = io_seek(off_t(__dirty_begin) - off_t(__io_offset), SEEK_CUR, &new_offset); e)
+		if(int e = _counted_io_seek(off_t(__dirty_begin) - off_t(__io_offset), SEEK_CUR,
+				&new_offset); e)
 			return e;
 		__io_offset = __dirty_begin;
+		_io_position = new_offset;
+		_io_position_known = true;
 	}else{
 		__ensure(_type == stream_type::pipe_like);
 		__ensure(__io_offset == __dirty_begin);
@@ -319,15 +560,21 @@ int abstract_file::_write_back() {
 	// Now, we are in the correct position to write-back everything.
 	while(__io_offset < __dirty_end) {
 		size_t io_size;
-		if(int e = io_write(__buffer_ptr + __io_offset, __dirty_end - __io_offset, &io_size); e) {
+		if(int e = _counted_io_write(__buffer_ptr + __io_offset, __dirty_end - __io_offset,
+				&io_size); e) {
 			__status_bits |= __MLIBC_ERROR_BIT;
 			return e;
 		}
 		__ensure(io_size > 0 && "io_write() is expected to always write at least one byte");
 		__io_offset += io_size;
 		__dirty_begin += io_size;
+		_io_position += io_size;
 	}
 
+	// The data was written to the end of the file, not to _io_position.
+	if(writes_append())
+		_io_position_known = false;
+
 	return 0;
 }
 
@@ -340,20 +587,60 @@ int abstract_file::_reset() {
 	if(_type == stream_type::pipe_like)
 		__ensure(__offset == __valid_limit);
 
+	// As seeks can move __offset within the buffer, the I/O position
+	// of file-like streams might not match the current offset.
+	if(_type == stream_type::file_like && __io_offset != __offset) {
+		off_t new_offset;
+		if(int e = _counted_io_seek(off_t(__offset) - off_t(__io_offset), SEEK_CUR, &new_offset); e)
+			return e;
+		_io_position = new_offset;
+		_io_position_known = true;
+	}
+
 	__ensure(__dirty_begin == __dirty_end);
 	__offset = 0;
 	__io_offset = 0;
 	__valid_limit = 0;
+	_pushed_back = false;
 
 	return 0;
 }
 
+// Called before each refill of the buffer.
+void abstract_file::_note_refill() {
+	if(_type != stream_type::file_like)
+		return;
+	if(++_sequential_refills < sequentialRefillThreshold)
+		return;
+
+	_random_seeks = 0;
+	if(_advice != POSIX_FADV_SEQUENTIAL) {
+		_advice = POSIX_FADV_SEQUENTIAL;
+		io_advise(_advice);
+	}
+	if(_preferred_buffer_size < maxBufferSize)
+		_preferred_buffer_size *= 2;
+}
+
+// Called when a seek moves the file position.
+void abstract_file::_note_random_seek() {
+	_sequential_refills = 0;
+	if(++_random_seeks < randomSeekThreshold)
+		return;
+
+	if(_advice != POSIX_FADV_RANDOM) {
+		_advice = POSIX_FADV_RANDOM;
+		io_advise(_advice);
+	}
+	_preferred_buffer_size = defaultBufferSize;
+}
+
 void abstract_file::_ensure_allocation() {
 	__ensure(__buffer_size);
 	if(__buffer_ptr)
 		return;
 
-	auto ptr = getAllocator().allocate(__buffer_size);
+	auto ptr = getFileAllocator().allocate(__buffer_size);
 	__buffer_ptr = reinterpret_cast<char *>(ptr);
 }
 
@@ -361,8 +648,16 @@ void abstract_file::_ensure_allocation() {
 // fd_file implementation.
 // --------------------------------------------------------------------------------------
 
-fd_file::fd_file(int fd, void (*do_dispose)(abstract_file *))
-: abstract_file{do_dispose}, _fd{fd} { }
+namespace {
+	// Buffer size of write-behind streams. As each write is a separate submission,
+	// the buffer should be much larger than the default.
+	constexpr size_t writeBehindBufferSize = 64 * 1024;
+}
+
+fd_file::fd_file(int fd, void (*do_dispose)(abstract_file *), bool append)
+: abstract_file{do_dispose}, _fd{fd}, _append{append}, _write_behind{false}, _write_pending{false},
+		_write_ticket{0}, _write_buffer{nullptr}, _write_capacity{0}, _write_size{0},
+		_position{0}, _position_known{false} { }
 
 int fd_file::fd() {
 	return _fd;
@@ -372,8 +667,25 @@ int fd_file::close() {
 	if(__dirty_begin != __dirty_end)
 		mlibc::infoLogger() << "mlibc warning: File is not flushed before closing"
 				<< frg::endlog;
+
+	// Even if the pending write failed, we still close the file descriptor.
+	int drain_error = io_drain();
+	if(_write_buffer) {
+		getFileAllocator().free(_write_buffer);
+		_write_buffer = nullptr;
+		_write_capacity = 0;
+	}
+
 	if(int e = mlibc::sys_close(_fd); e)
 		return e;
+	return drain_error;
+}
+
+int fd_file::enable_write_behind() {
+	if(!mlibc::sys_write_async || !mlibc::sys_write_async_wait)
+		return ENOSYS;
+	_write_behind = true;
+	_set_buffer_size(writeBehindBufferSize);
 	return 0;
 }
 
@@ -413,24 +725,556 @@ int fd_file::determine_bufmode(buffer_mode *mode) {
 }
 
 int fd_file::io_read(char *buffer, size_t max_size, size_t *actual_size) {
+	if(int e = io_drain(); e)
+		return e;
+
 	ssize_t s;
 	if(int e = mlibc::sys_read(_fd, buffer, max_size, &s); e)
 		return e;
+	_position += s;
 	*actual_size = s;
 	return 0;
 }
 
 int fd_file::io_write(const char *buffer, size_t max_size, size_t *actual_size) {
+	// Errors of the previous write are reported here.
+	if(int e = io_drain(); e)
+		return e;
+
+	if(_write_behind) {
+		if(_write_capacity < max_size) {
+			auto new_buffer = reinterpret_cast<char *>(getFileAllocator().allocate(max_size));
+			if(new_buffer) {
+				getFileAllocator().free(_write_buffer);
+				_write_buffer = new_buffer;
+				_write_capacity = max_size;
+			}
+		}
+
+		// If we cannot submit the write, we fall back to a synchronous write.
+		if(_write_capacity >= max_size) {
+			memcpy(_write_buffer, buffer, max_size);
+			if(!mlibc::sys_write_async(_fd, _write_buffer, max_size, &_write_ticket)) {
+				_write_pending = true;
+				_write_size = max_size;
+				_position += max_size;
+				if(_append)
+					_position_known = false;
+				*actual_size = max_size;
+				return 0;
+			}
+		}
+	}
+
 	ssize_t s;
 	if(int e = mlibc::sys_write(_fd, buffer, max_size, &s); e)
 		return e;
+	_position += s;
+	if(_append)
+		_position_known = false;
 	*actual_size = s;
 	return 0;
 }
 
 int fd_file::io_seek(off_t offset, int whence, off_t *new_offset) {
-	if(int e = mlibc::sys_seek(_fd, offset, whence, new_offset); e)
+	// abstract_file frequently queries the position before writing;
+	// answer that without waiting for the pending write.
+	if(_write_pending && _position_known && whence == SEEK_CUR && !offset) {
+		*new_offset = _position;
+		return 0;
+	}
+
+	if(int e = io_drain(); e)
+		return e;
+	if(int e = mlibc::sys_seek(_fd, offset, whence, new_offset); e) {
+		_position_known = false;
 		return e;
+	}
+	_position = *new_offset;
+	_position_known = true;
+	return 0;
+}
+
+int fd_file::io_drain() {
+	if(!_write_pending)
+		return 0;
+	_write_pending = false;
+
+	ssize_t s;
+	if(int e = mlibc::sys_write_async_wait(_write_ticket, &s); e) {
+		_position_known = false;
+		return e;
+	}
+
+	// Complete short writes synchronously. If no progress is made, we would never finish.
+	size_t progress = 0;
+	while(true) {
+		if(s <= 0) {
+			_position_known = false;
+			return EIO;
+		}
+		progress += s;
+		if(progress >= _write_size)
+			break;
+		if(int e = mlibc::sys_write(_fd, _write_buffer + progress, _write_size - progress, &s); e) {
+			_position_known = false;
+			return e;
+		}
+	}
+	return 0;
+}
+
+bool fd_file::writes_append() {
+	return _append;
+}
+
+int fd_file::io_advise(int advice) {
+	if(!mlibc::sys_fadvise)
+		return ENOSYS;
+	return mlibc::sys_fadvise(_fd, 0, 0, advice);
+}
+
+// --------------------------------------------------------------------------------------
+// mmap_file implementation.
+// --------------------------------------------------------------------------------------
+
+namespace {
+	// Size of the windows that we map (if the file is larger than that).
+	constexpr size_t mmapWindowSize = size_t(16) << 20;
+
+	// Size of the copy that replaces the window as the buffer once it is modified.
+	constexpr size_t unsharedBufferSize = 4096;
+}
+
+mmap_file::mmap_file(int fd, void (*do_dispose)(abstract_file *))
+: fd_file{fd, do_dispose}, _initialized{false}, _fallback{false}, _file_size{0},
+		_position{0}, _window{nullptr}, _window_size{0}, _window_offset{0},
+		_buffer_in_window{false} { }
+
+mmap_file::~mmap_file() {
+	// Prevent ~abstract_file() from freeing the mapping.
+	if(_buffer_in_window)
+		__buffer_ptr = nullptr;
+
+	if(!_window)
+		return;
+	if(mlibc::sys_vm_unmap(_window, _window_size))
+		mlibc::infoLogger() << "mlibc warning: Failed to unmap file window" << frg::endlog;
+}
+
+int mmap_file::determine_bufmode(buffer_mode *mode) {
+	*mode = buffer_mode::full_buffer;
+	return 0;
+}
+
+int mmap_file::io_read(char *buffer, size_t max_size, size_t *actual_size) {
+	if(int e = _init_mapping(); e)
+		return e;
+	if(_fallback)
+		return fd_file::io_read(buffer, max_size, actual_size);
+
+	if(_position >= _file_size) {
+		*actual_size = 0;
+		return 0;
+	}
+	if(int e = _map_window(); e)
+		return e;
+
+	auto limit = frg::min(_window_offset + off_t(_window_size), _file_size);
+	auto chunk = frg::min(size_t(limit - _position), max_size);
+	memcpy(buffer, _window + (_position - _window_offset), chunk);
+	_position += chunk;
+	*actual_size = chunk;
+	return 0;
+}
+
+int mmap_file::io_seek(off_t offset, int whence, off_t *new_offset) {
+	if(int e = _init_mapping(); e)
+		return e;
+	if(_fallback)
+		return fd_file::io_seek(offset, whence, new_offset);
+
+	off_t base;
+	if(whence == SEEK_SET) {
+		base = 0;
+	}else if(whence == SEEK_CUR) {
+		base = _position;
+	}else{
+		__ensure(whence == SEEK_END);
+		base = _file_size;
+	}
+
+	if(base + offset < 0)
+		return EINVAL;
+	_position = base + offset;
+	*new_offset = _position;
+	return 0;
+}
+
+int mmap_file::io_fill_buffer(size_t *actual_size) {
+	if(int e = _init_mapping(); e)
+		return e;
+	if(_fallback)
+		return fd_file::io_fill_buffer(actual_size);
+
+	if(_position >= _file_size) {
+		*actual_size = 0;
+		return 0;
+	}
+	if(int e = _map_window(); e)
+		return e;
+
+	// Drop the copy that io_unshare_buffer() made (if any).
+	if(!_buffer_in_window)
+		getFileAllocator().free(__buffer_ptr);
+
+	// Point the buffer into the window; no data is copied.
+	auto limit = frg::min(_window_offset + off_t(_window_size), _file_size);
+	__buffer_ptr = _window + (_position - _window_offset);
+	_buffer_in_window = true;
+	__buffer_size = limit - _position;
+	_position = limit;
+	*actual_size = __buffer_size;
+	return 0;
+}
+
+int mmap_file::io_unshare_buffer() {
+	if(!_buffer_in_window)
+		return 0;
+
+	// Copy the data around the current offset, keeping the character before it for unget().
+	// Data behind the copy is taken from the window again on the next refill.
+	size_t base = __offset ? __offset - 1 : 0;
+	size_t size = frg::min(size_t(__valid_limit - base), unsharedBufferSize - 1);
+	auto copy = reinterpret_cast<char *>(getFileAllocator().allocate(unsharedBufferSize));
+	if(!copy)
+		return ENOMEM;
+	memcpy(copy, __buffer_ptr + base, size);
+
+	// __io_offset may now exceed __valid_limit; _reset() seeks back in that case.
+	__buffer_ptr = copy;
+	__buffer_size = unsharedBufferSize;
+	__offset -= base;
+	__io_offset -= base;
+	__valid_limit = size;
+	_buffer_in_window = false;
+	return 0;
+}
+
+int mmap_file::_init_mapping() {
+	if(_initialized)
+		return 0;
+	_initialized = true;
+
+	// Only regular files with a known size can be mapped. Note that some files
+	// (e.g. in procfs) report a size of zero even though they have contents.
+	if(!mlibc::sys_stat) {
+		_fallback = true;
+		return 0;
+	}
+	struct stat info;
+	if(int e = mlibc::sys_stat(fsfd_target::fd, fd(), nullptr, 0, &info); e)
+		return e;
+	if(!S_ISREG(info.st_mode) || !info.st_size) {
+		_fallback = true;
+		return 0;
+	}
+
+	// Start at the current position of the FD.
+	if(int e = fd_file::io_seek(0, SEEK_CUR, &_position); e)
+		return e;
+	_file_size = info.st_size;
+
+	// Not all sysdeps can map files. Since nothing has been consumed yet,
+	// the FD is still at _position and we can switch to read() transparently.
+	if(_position < _file_size && _map_window())
+		_fallback = true;
+	return 0;
+}
+
+int mmap_file::_map_window() {
+	if(_window && _position >= _window_offset
+			&& _position < _window_offset + off_t(_window_size))
+		return 0;
+
+	if(_window) {
+		if(int e = mlibc::sys_vm_unmap(_window, _window_size); e)
+			return e;
+		_window = nullptr;
+		if(_buffer_in_window) {
+			__buffer_ptr = nullptr;
+			_buffer_in_window = false;
+		}
+	}
+
+	auto offset = _position & ~off_t(page_size - 1);
+	auto size = frg::min(size_t(_file_size - offset), mmapWindowSize);
+
+	// The buffer is never modified while it points into the window (see io_unshare_buffer()).
+	void *window;
+	if(int e = mlibc::sys_vm_map(nullptr, size, PROT_READ, MAP_PRIVATE,
+			fd(), offset, &window); e)
+		return e;
+	_window = reinterpret_cast<char *>(window);
+	_window_size = size;
+	_window_offset = offset;
+
+	// We consume windows sequentially; ask the OS to populate the window.
+	if(mlibc::sys_vm_readahead)
+		if(mlibc::sys_vm_readahead(_window, _window_size))
+			mlibc::infoLogger() << "mlibc: sys_vm_readahead() failed in mmap_file"
+					<< frg::endlog;
+	return 0;
+}
+
+// --------------------------------------------------------------------------------------
+// mem_file implementation.
+// --------------------------------------------------------------------------------------
+
+mem_file::mem_file(char *memory, size_t size, int flags, bool owns_memory,
+		void (*do_dispose)(abstract_file *))
+: abstract_file{do_dispose}, _memory{memory}, _size{size}, _length{size}, _position{0},
+		_flags{flags}, _owns_memory{owns_memory} {
+	if(_flags & __MLIBC_O_TRUNC) {
+		_length = 0;
+		if(_size)
+			_memory[0] = 0;
+	}else if(_flags & __MLIBC_O_APPEND) {
+		// Appending starts at the first null byte.
+		auto nul = reinterpret_cast<char *>(memchr(_memory, 0, _size));
+		if(nul)
+			_length = nul - _memory;
+		_position = _length;
+	}
+}
+
+int mem_file::close() {
+	if(_owns_memory)
+		getAllocator().free(_memory);
+	return 0;
+}
+
+int mem_file::determine_type(stream_type *type) {
+	*type = stream_type::file_like;
+	return 0;
+}
+
+int mem_file::determine_bufmode(buffer_mode *mode) {
+	// The memory region itself acts as the buffer; do not copy the data twice.
+	*mode = buffer_mode::no_buffer;
+	return 0;
+}
+
+int mem_file::io_read(char *buffer, size_t max_size, size_t *actual_size) {
+	if((_flags & __MLIBC_O_ACCMODE) == __MLIBC_O_WRONLY)
+		return EBADF;
+
+	if(_position >= _length) {
+		*actual_size = 0;
+		return 0;
+	}
+
+	auto chunk = frg::min(_length - _position, max_size);
+	memcpy(buffer, _memory + _position, chunk);
+	_position += chunk;
+	*actual_size = chunk;
+	return 0;
+}
+
+int mem_file::io_write(const char *buffer, size_t max_size, size_t *actual_size) {
+	if((_flags & __MLIBC_O_ACCMODE) == __MLIBC_O_RDONLY)
+		return EBADF;
+
+	if(_flags & __MLIBC_O_APPEND)
+		_position = _length;
+	if(_position >= _size)
+		return ENOSPC;
+
+	auto chunk = frg::min(_size - _position, max_size);
+	memcpy(_memory + _position, buffer, chunk);
+	_position += chunk;
+
+	if(_position > _length) {
+		_length = _position;
+		// Keep the contents null-terminated as long as there is space left.
+		if(_length < _size)
+			_memory[_length] = 0;
+	}
+
+	*actual_size = chunk;
+	return 0;
+}
+
+int mem_file::io_seek(off_t offset, int whence, off_t *new_offset) {
+	off_t base;
+	if(whence == SEEK_SET) {
+		base = 0;
+	}else if(whence == SEEK_CUR) {
+		base = _position;
+	}else{
+		__ensure(whence == SEEK_END);
+		base = _length;
+	}
+
+	if(offset < -base || offset > off_t(_size) - base)
+		return EINVAL;
+
+	_position = base + offset;
+	*new_offset = _position;
+	return 0;
+}
+
+// --------------------------------------------------------------------------------------
+// memstream_file implementation.
+// --------------------------------------------------------------------------------------
+
+memstream_file::memstream_file(char **ptr, size_t *sizeloc, char *initial, size_t capacity,
+		void (*do_dispose)(abstract_file *))
+: abstract_file{do_dispose}, _ptr{ptr}, _sizeloc{sizeloc}, _memory{initial},
+		_capacity{capacity}, _length{0}, _position{0} {
+	__ensure(_capacity);
+	_memory[0] = 0;
+	_publish();
+}
+
+int memstream_file::close() {
+	// The buffer is owned by the user; it is not freed here.
+	_publish();
+	return 0;
+}
+
+int memstream_file::determine_type(stream_type *type) {
+	*type = stream_type::file_like;
+	return 0;
+}
+
+int memstream_file::determine_bufmode(buffer_mode *mode) {
+	*mode = buffer_mode::no_buffer;
+	return 0;
+}
+
+int memstream_file::io_read(char *, size_t, size_t *) {
+	// open_memstream() streams are write-only.
+	return EBADF;
+}
+
+int memstream_file::io_write(const char *buffer, size_t max_size, size_t *actual_size) {
+	// Reserve one additional byte for the null-terminator.
+	if(_position + max_size >= _capacity) {
+		auto new_capacity = frg::max(2 * _capacity, _position + max_size + 1);
+		auto new_memory = reinterpret_cast<char *>(realloc(_memory, new_capacity));
+		if(!new_memory)
+			return ENOMEM;
+		_memory = new_memory;
+		_capacity = new_capacity;
+	}
+
+	// Seeking past the end and writing fills the gap with zeros.
+	if(_position > _length)
+		memset(_memory + _length, 0, _position - _length);
+
+	memcpy(_memory + _position, buffer, max_size);
+	_position += max_size;
+	_length = frg::max(_length, _position);
+	_memory[_length] = 0;
+	_publish();
+
+	*actual_size = max_size;
+	return 0;
+}
+
+int memstream_file::io_seek(off_t offset, int whence, off_t *new_offset) {
+	off_t base;
+	if(whence == SEEK_SET) {
+		base = 0;
+	}else if(whence == SEEK_CUR) {
+		base = _position;
+	}else{
+		__ensure(whence == SEEK_END);
+		base = _length;
+	}
+
+	if(offset < -base)
+		return EINVAL;
+
+	_position = base + offset;
+	_publish();
+	*new_offset = _position;
+	return 0;
+}
+
+void memstream_file::_publish() {
+	*_ptr = _memory;
+	// After a seek past the end, the size does not cover the gap (until it is written).
+	*_sizeloc = frg::min(_position, _length);
+}
+
+// --------------------------------------------------------------------------------------
+// cookie_file implementation.
+// --------------------------------------------------------------------------------------
+
+cookie_file::cookie_file(void *cookie, cookie_io_functions_t io_funcs,
+		void (*do_dispose)(abstract_file *))
+: abstract_file{do_dispose}, _cookie{cookie}, _io_funcs{io_funcs} { }
+
+int cookie_file::close() {
+	if(!_io_funcs.close)
+		return 0;
+	if(_io_funcs.close(_cookie))
+		return EIO;
+	return 0;
+}
+
+int cookie_file::determine_type(stream_type *type) {
+	// Without a seek function, we have to treat the cookie like a pipe.
+	if(_io_funcs.seek) {
+		*type = stream_type::file_like;
+	}else{
+		*type = stream_type::pipe_like;
+	}
+	return 0;
+}
+
+int cookie_file::determine_bufmode(buffer_mode *mode) {
+	*mode = buffer_mode::full_buffer;
+	return 0;
+}
+
+int cookie_file::io_read(char *buffer, size_t max_size, size_t *actual_size) {
+	// A missing read function behaves as if the stream is always at EOF.
+	if(!_io_funcs.read) {
+		*actual_size = 0;
+		return 0;
+	}
+
+	auto s = _io_funcs.read(_cookie, buffer, max_size);
+	if(s < 0)
+		return EIO;
+	*actual_size = s;
+	return 0;
+}
+
+int cookie_file::io_write(const char *buffer, size_t max_size, size_t *actual_size) {
+	// A missing write function silently discards all data.
+	if(!_io_funcs.write) {
+		*actual_size = max_size;
+		return 0;
+	}
+
+	auto s = _io_funcs.write(_cookie, buffer, max_size);
+	if(s <= 0)
+		return EIO;
+	*actual_size = s;
+	return 0;
+}
+
+int cookie_file::io_seek(off_t offset, int whence, off_t *new_offset) {
+	if(!_io_funcs.seek)
+		return ESPIPE;
+
+	if(_io_funcs.seek(_cookie, &offset, whence))
+		return EIO;
+	*new_offset = offset;
 	return 0;
 }
 
@@ -460,8 +1304,13 @@ FILE *stdin = &stdin_file;
 FILE *stdout = &stdout_file;
 
 int fileno_unlocked(FILE *file_base) {
-	auto file = static_cast<mlibc::fd_file *>(file_base);
-	return file->fd();
+	auto file = static_cast<mlibc::abstract_file *>(file_base);
+	int fd = file->fd();
+	if(fd < 0) {
+		errno = EBADF;
+		return -1;
+	}
+	return fd;
 }
 
 int fileno(FILE *file_base) {
@@ -485,12 +1334,23 @@ FILE *fopen(const char *path, const char *mode) {
 			flags = __MLIBC_O_WRONLY;
 		}
 		flags |= __MLIBC_O_CREAT | __MLIBC_O_TRUNC;
+	}else if(*mode == 'a') {
+		if(has_plus) {
+			flags = __MLIBC_O_RDWR;
+		}else{
+			flags = __MLIBC_O_WRONLY;
+		}
+		flags |= __MLIBC_O_CREAT | __MLIBC_O_APPEND;
 	}else{
 		mlibc::infoLogger() << "Illegal fopen() mode '" << *mode << "'" << frg::endlog;
+		errno = EINVAL;
+		return nullptr;
 	}
 	mode += 1;
 
 	// Consume additional flags.
+	bool use_mmap = false;
+	bool use_write_behind = false;
 	while(*mode) {
 		if(*mode == '+') {
 			mode++; // This is already handled above.
@@ -499,6 +1359,12 @@ FILE *fopen(const char *path, const char *mode) {
 		}else if(*mode == 'e') {
 			flags |= __MLIBC_O_CLOEXEC;
 			mode++;
+		}else if(*mode == 'm') {
+			use_mmap = true;
+			mode++;
+		}else if(*mode == 'q') {
+			use_write_behind = true;
+			mode++;
 		}else{
 			mlibc::infoLogger() << "Illegal fopen() flag '" << mode << "'" << frg::endlog;
 			mode++;
@@ -510,17 +1376,30 @@ FILE *fopen(const char *path, const char *mode) {
 		errno = e;
 		return nullptr;
 	}
-	return frg::construct<mlibc::fd_file>(getAllocator(), fd,
-			[] (mlibc::abstract_file *abstract) { frg::destruct(getAllocator(), abstract); });
+
+	// Mapping the file is only possible for read-only streams. mmap_file needs sys_stat()
+	// to find the size of the file; it falls back to read() if sys_vm_map() fails.
+	if(use_mmap && mlibc::sys_stat && (flags & __MLIBC_O_ACCMODE) == __MLIBC_O_RDONLY)
+		return frg::construct<mlibc::mmap_file>(mlibc::getFileAllocator(), fd,
+				[] (mlibc::abstract_file *abstract) {
+					frg::destruct(mlibc::getFileAllocator(), abstract);
+				});
+	auto file = frg::construct<mlibc::fd_file>(mlibc::getFileAllocator(), fd,
+			[] (mlibc::abstract_file *abstract) {
+				frg::destruct(mlibc::getFileAllocator(), abstract);
+			}, (flags & __MLIBC_O_APPEND) != 0);
+	// Write-behind is only a hint; if the sysdeps lack support, we use synchronous I/O.
+	if(use_write_behind)
+		file->enable_write_behind();
+	return file;
 }
 
 FILE *fdopen(int fd, const char *mode) {
-	mlibc::infoLogger() << "\e[31mmlibc: fdopen() ignores the file mode"
-			<< "\e[39m" << frg::endlog;
-	(void)mode;
-
-	return frg::construct<mlibc::fd_file>(getAllocator(), fd,
-			[] (mlibc::abstract_file *abstract) { frg::destruct(getAllocator(), abstract); });
+	// The FD already has its access mode; we only need to know whether writes append.
+	return frg::construct<mlibc::fd_file>(mlibc::getFileAllocator(), fd,
+			[] (mlibc::abstract_file *abstract) {
+				frg::destruct(mlibc::getFileAllocator(), abstract);
+			}, *mode == 'a');
 }
 
 int fclose(FILE *file_base) {
@@ -596,9 +1475,14 @@ void rewind(FILE *file_base) {
 }
 
 int ungetc(int c, FILE *file_base) {
+	if(c == EOF)
+		return EOF;
+
 	auto file = static_cast<mlibc::abstract_file *>(file_base);
-	file->unget(c);
-	return c;
+	if(file->unget(c))
+		return EOF;
+	file_base->__status_bits &= ~__MLIBC_EOF_BIT;
+	return static_cast<unsigned char>(c);
 }
 
 void __fpurge(FILE *file_base) {
@@ -606,3 +1490,22 @@ void __fpurge(FILE *file_base) {
 	file->purge();
 }
 
+int __fstats(FILE *file_base, struct __mlibc_fstats *stats) {
+	auto file = static_cast<mlibc::abstract_file *>(file_base);
+	*stats = file->stats();
+	return 0;
+}
+
+void __fstats_dump(FILE *out) {
+	for(auto it : mlibc::global_file_list) {
+		// Take a copy, as writing to out changes its statistics.
+		auto stats = it->stats();
+		fprintf(out, "FILE %p: buffer %zu, refills %lu, write-backs %lu,"
+				" reads %lu, writes %lu (%lu partial), seeks %lu, in %llu, out %llu\n",
+				static_cast<FILE *>(it), it->__buffer_size, stats.refills, stats.write_backs,
+				stats.reads, stats.writes, stats.partial_writes, stats.seeks,
+				stats.bytes_read, stats.bytes_written);
+	}
+	fflush(out);
+}
+
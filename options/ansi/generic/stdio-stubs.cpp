@@ -10,10 +10,76 @@
 
 #include <bits/ensure.h>
 
+#include <mlibc/charcode.hpp>
 #include <mlibc/debug.hpp>
 #include <mlibc/file-io.hpp>
+#include <mlibc/float-format.hpp>
+#include <mlibc/int-format.hpp>
 #include <mlibc/sysdeps.hpp>
 
+namespace {
+
+// Encodes a single wide character in the current charcode.
+// Returns the number of code units or -1 if the character cannot be encoded.
+int encode_wide_char(wchar_t wc, char *units) {
+	auto cc = mlibc::current_charcode();
+	if(static_cast<uint32_t>(wc) < 0x80 && cc->preserves_7bit_units) {
+		units[0] = wc;
+		return 1;
+	}
+
+	// The charcode stops at null characters; those are handled by the fast path above
+	// unless the charcode does not preserve ASCII.
+	if(!wc) {
+		units[0] = 0;
+		return 1;
+	}
+
+	__mlibc_mbstate st = __MLIBC_MBSTATE_INITIALIZER;
+	mlibc::code_seq<char> nseq{units, units + MB_CUR_MAX};
+	mlibc::code_seq<const wchar_t> wseq{&wc, &wc + 1};
+	if(cc->encode_wtranscode(nseq, wseq, st) != mlibc::charcode_error::null
+			|| wseq.it != wseq.end)
+		return -1;
+	return nseq.it - units;
+}
+
+// Decodes code units into wide characters until either sequence is exhausted.
+// Runs of ASCII characters are copied directly instead of going through the charcode.
+mlibc::charcode_error widen(mlibc::code_seq<const char> &nseq,
+		mlibc::code_seq<wchar_t> &wseq) {
+	auto cc = mlibc::current_charcode();
+	while(nseq && wseq) {
+		if(cc->preserves_7bit_units) {
+			auto in = nseq.it;
+			auto out = wseq.it;
+			while(in != nseq.end && out != wseq.end) {
+				auto uc = static_cast<unsigned char>(*in);
+				if(uc >= 0x80)
+					break;
+				*out++ = uc;
+				in++;
+			}
+			nseq.it = in;
+			wseq.it = out;
+			if(!nseq || !wseq)
+				break;
+		}
+
+		// Decode a single character.
+		__mlibc_mbstate st = __MLIBC_MBSTATE_INITIALIZER;
+		mlibc::code_seq<wchar_t> single{wseq.it, wseq.it + 1};
+		if(auto e = cc->decode_wtranscode(nseq, single, st); e != mlibc::charcode_error::null)
+			return e;
+		if(single.it == wseq.it) // The charcode does not produce null characters.
+			*single.it++ = 0;
+		wseq.it = single.it;
+	}
+	return mlibc::charcode_error::null;
+}
+
+} // anonymous namespace
+
 template<typename F>
 struct PrintfAgent {
 	PrintfAgent(F *formatter, frg::va_struct *vsp)
@@ -29,13 +95,18 @@ struct PrintfAgent {
 	void operator() (char t, frg::format_options opts, frg::printf_size_mod szmod) {
 		switch(t) {
 		case 'p': case 'c': case 's':
+			if(t != 'p' && szmod == frg::printf_size_mod::long_size) {
+				_format_wide_chars(t, opts);
+				break;
+			}
 			frg::do_printf_chars(*_formatter, t, opts, szmod, _vsp);
 			break;
 		case 'd': case 'i': case 'o': case 'x': case 'X': case 'u':
-			frg::do_printf_ints(*_formatter, t, opts, szmod, _vsp);
+			if(!_format_plain_int(t, opts, szmod))
+				frg::do_printf_ints(*_formatter, t, opts, szmod, _vsp);
 			break;
 		case 'f': case 'F': case 'g': case 'G': case 'e': case 'E':
-			frg::do_printf_floats(*_formatter, t, opts, szmod, _vsp);
+			mlibc::do_printf_floats(*_formatter, t, opts, szmod, _vsp);
 			break;
 		case 'm':
 			__ensure(!opts.fill_zeros);
@@ -60,31 +131,152 @@ struct PrintfAgent {
 	}
 
 private:
+	// Fast path for %d, %i, %u, %x and %X without flags, width or precision.
+	// Returns false (without consuming an argument) if frigg needs to handle the conversion.
+	bool _format_plain_int(char t, frg::format_options opts, frg::printf_size_mod szmod) {
+		if(t == 'o' || opts.left_justify || opts.always_sign || opts.plus_becomes_space
+				|| opts.alt_conversion || opts.fill_zeros || opts.minimum_width
+				|| opts.precision)
+			return false;
+
+		bool is_signed = t == 'd' || t == 'i';
+		uint64_t value;
+		int64_t signed_value;
+		switch(szmod) {
+		case frg::printf_size_mod::default_size:
+			if(is_signed) {
+				signed_value = va_arg(_vsp->args, int);
+			}else{
+				value = va_arg(_vsp->args, unsigned int);
+			}
+			break;
+		case frg::printf_size_mod::long_size:
+			if(is_signed) {
+				signed_value = va_arg(_vsp->args, long);
+			}else{
+				value = va_arg(_vsp->args, unsigned long);
+			}
+			break;
+		case frg::printf_size_mod::longlong_size:
+			if(is_signed) {
+				signed_value = va_arg(_vsp->args, long long);
+			}else{
+				value = va_arg(_vsp->args, unsigned long long);
+			}
+			break;
+		default:
+			return false;
+		}
+
+		char buffer[mlibc::max_integer_digits + 1];
+		int n;
+		if(is_signed) {
+			n = mlibc::format_signed_decimal(buffer, signed_value);
+		}else if(t == 'u') {
+			n = mlibc::format_decimal(buffer, value);
+		}else{
+			n = mlibc::format_hex(buffer, value, t == 'X');
+		}
+		_formatter->append(buffer, n);
+		return true;
+	}
+
+	// Handles %lc and %ls by encoding the wide characters in the current charcode.
+	// Output stops at characters that cannot be encoded.
+	void _format_wide_chars(char t, frg::format_options opts) {
+		wchar_t single[2] = {0, 0};
+		const wchar_t *s;
+		size_t max_chars = SIZE_MAX;
+		if(t == 'c') {
+			single[0] = va_arg(_vsp->args, wint_t);
+			s = single;
+			max_chars = 1;
+		}else{
+			s = va_arg(_vsp->args, const wchar_t *);
+			if(!s)
+				s = L"(null)";
+		}
+
+		// For %ls, the precision limits the number of code units.
+		size_t max_units = SIZE_MAX;
+		if(t == 's' && opts.precision)
+			max_units = *opts.precision;
+
+		char units[MB_CUR_MAX];
+		size_t length = 0;
+		size_t n = 0;
+		for(; n < max_chars && (t == 'c' || s[n]); n++) {
+			int k = encode_wide_char(s[n], units);
+			if(k < 0 || length + k > max_units)
+				break;
+			length += k;
+		}
+
+		size_t width = opts.minimum_width > 0 ? opts.minimum_width : 0;
+		auto pad = [&] {
+			for(size_t i = length; i < width; i++)
+				_formatter->append(' ');
+		};
+
+		if(!opts.left_justify)
+			pad();
+		for(size_t i = 0; i < n; i++)
+			_formatter->append(units, encode_wide_char(s[i], units));
+		if(opts.left_justify)
+			pad();
+	}
+
 	F *_formatter;
 	frg::va_struct *_vsp;
 };
 
+// Collects output in a local buffer before passing it to the stream.
+// Apart from avoiding per-character fwrite() calls, this ensures that
+// (reasonably sized) messages reach unbuffered streams (like stderr) in a single write.
 struct StreamPrinter {
 	StreamPrinter(FILE *stream)
-	: stream(stream), count(0) { }
+	: stream(stream), count(0), _buffered(0) { }
+
+	StreamPrinter(const StreamPrinter &) = delete;
 
 	void append(char c) {
-		fwrite(&c, 1, 1, stream);
+		if(_buffered == sizeof(_buffer))
+			flush();
+		_buffer[_buffered++] = c;
 		count++;
 	}
 
 	void append(const char *str) {
-		fwrite(str, strlen(str), 1, stream);
-		count += strlen(str);
+		append(str, strlen(str));
 	}
 
 	void append(const char *str, size_t n) {
-		fwrite(str, n, 1, stream);
+		if(_buffered + n > sizeof(_buffer)) {
+			flush();
+			if(n > sizeof(_buffer)) {
+				fwrite(str, n, 1, stream);
+				count += n;
+				return;
+			}
+		}
+		memcpy(_buffer + _buffered, str, n);
+		_buffered += n;
 		count += n;
 	}
 
+	void flush() {
+		if(!_buffered)
+			return;
+		fwrite(_buffer, _buffered, 1, stream);
+		_buffered = 0;
+	}
+
 	FILE *stream;
 	size_t count;
+
+private:
+	char _buffer[512];
+	size_t _buffered;
 };
 
 struct BufferPrinter {
@@ -229,8 +421,11 @@ int fprintf(FILE *__restrict stream, const char *__restrict format, ...) {
 	return result;
 }
 int fscanf(FILE *__restrict stream, const char *__restrict format, ...) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
+	va_list args;
+	va_start(args, format);
+	int result = vfscanf(stream, format, args);
+	va_end(args);
+	return result;
 }
 int printf(const char *__restrict format, ...) {
 	va_list args;
@@ -284,6 +479,120 @@ static void store_int(void *dest, unsigned int size, unsigned long long i) {
     }
 }
 
+// Reads an integer like strtoull() (including a sign and a 0x prefix), but consumes
+// at most width characters if width is non-zero. A base of zero detects the base
+// from the prefix, as %i does. Returns false if no digits were matched.
+template<typename H>
+static bool scan_int(H &handler, int width, unsigned int base, unsigned long long *result) {
+    int count = 0;
+    auto more = [&] { return !width || count < width; };
+    char c = handler.look_ahead();
+    auto take = [&] {
+        handler.consume();
+        count++;
+        c = handler.look_ahead();
+    };
+
+    bool negative = false;
+    if ((c == '+' || c == '-') && more()) {
+        negative = c == '-';
+        take();
+    }
+
+    bool matched = false;
+    if ((base == 0 || base == 16) && c == '0' && more()) {
+        take();
+        matched = true;
+        if ((c == 'x' || c == 'X') && more()) {
+            take();
+            base = 16;
+        } else if (!base) {
+            base = 8;
+        }
+    }
+    if (!base)
+        base = 10;
+
+    unsigned long long res = 0;
+    while (more()) {
+        unsigned int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'z')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'Z')
+            digit = c - 'A' + 10;
+        else
+            break;
+        if (digit >= base)
+            break;
+        take();
+        res = res * base + digit;
+        matched = true;
+    }
+
+    *result = negative ? -res : res;
+    return matched;
+}
+
+// Reads a floating point number (in any form that strtod() accepts) into buffer,
+// consuming at most width characters if width is non-zero. As we can only look
+// ahead by one character, an incomplete suffix (e.g. the "e+" of "1e+") is consumed
+// but ignored, like glibc does. Returns false if no number was matched.
+template<typename H>
+static bool scan_float(H &handler, int width, char *buffer, size_t size) {
+    size_t count = 0;
+    size_t limit = size - 1;
+    if (width && size_t(width) < limit)
+        limit = width;
+    char c = handler.look_ahead();
+    auto take = [&] {
+        buffer[count++] = handler.consume();
+        c = handler.look_ahead();
+    };
+
+    if ((c == '+' || c == '-') && count < limit)
+        take();
+
+    if (c == 'i' || c == 'I' || c == 'n' || c == 'N') {
+        // inf, infinity and nan.
+        while (isalpha(c) && count < limit)
+            take();
+    } else {
+        bool hex = false;
+        if (c == '0' && count < limit) {
+            take();
+            if ((c == 'x' || c == 'X') && count < limit) {
+                take();
+                hex = true;
+            }
+        }
+        bool point = false;
+        while (count < limit) {
+            if (c == '.' && !point) {
+                point = true;
+            } else if (!(hex ? isxdigit(c) : isdigit(c))) {
+                break;
+            }
+            take();
+        }
+        if ((hex ? (c == 'p' || c == 'P') : (c == 'e' || c == 'E')) && count < limit) {
+            take();
+            if ((c == '+' || c == '-') && count < limit)
+                take();
+            while (isdigit(c) && count < limit)
+                take();
+        }
+    }
+    buffer[count] = 0;
+
+    if (!count)
+        return false;
+    char *end;
+    strtold(buffer, &end);
+    return end != buffer;
+}
+
 template<typename H>
 static int do_scanf(H &handler, const char *fmt, __gnuc_va_list args) {
     int match_count = 0;
@@ -299,8 +608,14 @@ static int do_scanf(H &handler, const char *fmt, __gnuc_va_list args) {
         if (*fmt != '%' || fmt[1] == '%') {
             if (*fmt == '%')
                 fmt++;
-            char c = handler.consume();
-            if (c != *fmt) return -1;
+            char c = handler.look_ahead();
+            if (c != *fmt) {
+                // Running out of input before the first conversion is an input failure.
+                if (!c && !match_count)
+                    return EOF;
+                return match_count;
+            }
+            handler.consume();
             continue;
         }
 
@@ -340,7 +655,6 @@ static int do_scanf(H &handler, const char *fmt, __gnuc_va_list args) {
 
         /* type modifiers */
         unsigned int type = SCANF_TYPE_INT;
-        unsigned int base = 10;
         switch (*fmt) {
             case 'h': {
                 if (fmt[1] == 'h') {
@@ -387,114 +701,59 @@ static int do_scanf(H &handler, const char *fmt, __gnuc_va_list args) {
                 fmt++;
                 break;
             }
-            case '0': {
-                if (fmt[1] == 'x' || fmt[1] == 'X') {
-                    base = 16;
-                    fmt += 2;
-                    break;
-                }
-                base = 8;
-                fmt++;
-                break;
-            }
         }
 
+        // All conversions except %c, %[ and %n skip leading white space.
+        if (*fmt != 'c' && *fmt != '[' && *fmt != 'n') {
+            while (isspace(handler.look_ahead()))
+                handler.consume();
+        }
+        if (*fmt != 'n' && !handler.look_ahead())
+            return match_count ? match_count : EOF;
+        int consumed_before = handler.num_consumed;
+
         switch (*fmt) {
             case 'd':
+            case 'i':
             case 'u':
-                base = 10;
-                /* fallthrough */
-            case 'i': {
-                unsigned long long res = 0;
-                char c = handler.look_ahead();
-                switch (base) {
-                    case 10:
-                        while (c >= '0' && c <= '9') {
-                            handler.consume();
-                            res = res * 10 + (c - '0');
-                            c = handler.look_ahead();
-                        }
-                        break;
-                    case 16:
-                        if (c == '0') {
-                            handler.consume();
-                            c = handler.look_ahead();
-                            if (c == 'x') {
-                                handler.consume();
-                                c = handler.look_ahead();
-                            }
-                        }
-                        while (true) {
-                            if (c >= '0' && c <= '9') {
-                                handler.consume();
-                                res = res * 16 + (c - '0');
-                            } else if (c >= 'a' && c <= 'f') {
-                                handler.consume();
-                                res = res * 16 + (c - 'a');
-                            } else if (c >= 'A' && c <= 'F') {
-                                handler.consume();
-                                res = res * 16 + (c - 'A');
-                            } else {
-                                break;
-                            }
-                            c = handler.look_ahead();
-                        }
-                        break;
-                    case 8:
-                        while (c >= '0' && c <= '7') {
-                            handler.consume();
-                            res = res * 10 + (c - '0');
-                            c = handler.look_ahead();
-                        }
-                        break;
-                }
-                if (dest)
-                    store_int(dest, type, res);
-                break;
-            }
-            case 'o': {
-                unsigned long long res = 0;
-                char c = handler.look_ahead();
-                while (c >= '0' && c <= '7') {
-                    handler.consume();
-                    res = res * 10 + (c - '0');
-                    c = handler.look_ahead();
-                }
-                if (dest)
-                    store_int(dest, type, res);
-                break;
-            }
+            case 'o':
             case 'x':
             case 'X': {
-                unsigned long long res = 0;
-                char c = handler.look_ahead();
-                if (c == '0') {
-                    handler.consume();
-                    c = handler.look_ahead();
-                    if (c == 'x') {
-                        handler.consume();
-                        c = handler.look_ahead();
-                    }
-                }
-                while (true) {
-                    if (c >= '0' && c <= '9') {
-                        handler.consume();
-                        res = res * 16 + (c - '0');
-                    } else if (c >= 'a' && c <= 'f') {
-                        handler.consume();
-                        res = res * 16 + (c - 'a');
-                    } else if (c >= 'A' && c <= 'F') {
-                        handler.consume();
-                        res = res * 16 + (c - 'A');
-                    } else {
-                        break;
-                    }
-                    c = handler.look_ahead();
-                }
+                unsigned int base = 16;
+                if (*fmt == 'd' || *fmt == 'u')
+                    base = 10;
+                else if (*fmt == 'i')
+                    base = 0;
+                else if (*fmt == 'o')
+                    base = 8;
+                unsigned long long res;
+                if (!scan_int(handler, width, base, &res))
+                    return match_count;
                 if (dest)
                     store_int(dest, type, res);
                 break;
             }
+            case 'a':
+            case 'A':
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G': {
+                char buffer[128];
+                if (!scan_float(handler, width, buffer, sizeof(buffer)))
+                    return match_count;
+                if (!dest)
+                    break;
+                if (type == SCANF_TYPE_L)
+                    *(double *)dest = strtod(buffer, nullptr);
+                else if (type == SCANF_TYPE_LL)
+                    *(long double *)dest = strtold(buffer, nullptr);
+                else
+                    *(float *)dest = strtof(buffer, nullptr);
+                break;
+            }
             case 's': {
                 char *typed_dest = (char *)dest;
                 char c = handler.look_ahead();
@@ -509,7 +768,7 @@ static int do_scanf(H &handler, const char *fmt, __gnuc_va_list args) {
                         break;
                 }
                 if (typed_dest)
-                    typed_dest[count + 1] = '\0';
+                    typed_dest[count] = '\0';
                 break;
             }
             case 'c': {
@@ -547,60 +806,41 @@ static int do_scanf(H &handler, const char *fmt, __gnuc_va_list args) {
                     scanset[1+']'] = 1 - invert;
                 }
 
+                // Characters index the scanset as unsigned char; plain char may be signed.
                 for (; *fmt != ']'; fmt++) {
                     if (!*fmt) return EOF;
-                    if (*fmt == '-' && *fmt != ']') {
+                    // A '-' right before the closing ']' is not a range.
+                    if (*fmt == '-' && fmt[1] != ']') {
                         fmt++;
-                        for (char c = *(fmt - 2); c < *fmt; c++)
+                        for (unsigned int c = (unsigned char)fmt[-2]; c < (unsigned char)*fmt; c++)
                             scanset[1 + c] = 1 - invert;
                     }
-                    scanset[1 + *fmt] = 1 - invert;
+                    scanset[1 + (unsigned char)*fmt] = 1 - invert;
                 }
 
                 char *typed_dest = (char *)dest;
                 int count = 0;
                 char c = handler.look_ahead();
-                while (c && count < width) {
-                    handler.consume();
-                    if (!scanset[1 + c])
+                while (c && (!width || count < width)) {
+                    if (!scanset[1 + (unsigned char)c])
                         break;
+                    handler.consume();
                     if (typed_dest)
                         typed_dest[count] = c;
                     c = handler.look_ahead();
                     count++;
                 }
-                if (typed_dest)
+                if (typed_dest && count)
                     typed_dest[count] = '\0';
                 break;
             }
             case 'p': {
-                unsigned long long res = 0;
-                char c = handler.look_ahead();
-                if (c == '0') {
-                    handler.consume();
-                    c = handler.look_ahead();
-                    if (c == 'x') {
-                        handler.consume();
-                        c = handler.look_ahead();
-                    }
-                }
-                while (true) {
-                    if (c >= '0' && c <= '9') {
-                        handler.consume();
-                        res = res * 16 + (c - '0');
-                    } else if (c >= 'a' && c <= 'f') {
-                        handler.consume();
-                        res = res * 16 + (c - 'a');
-                    } else if (c >= 'A' && c <= 'F') {
-                        handler.consume();
-                        res = res * 16 + (c - 'A');
-                    } else {
-                        break;
-                    }
-                    c = handler.look_ahead();
-                }
+                unsigned long long res;
+                if (!scan_int(handler, width, 16, &res))
+                    return match_count;
                 void **typed_dest = (void **)dest;
-                *typed_dest = (void *)(uintptr_t)res;
+                if (typed_dest)
+                    *typed_dest = (void *)(uintptr_t)res;
                 break;
             }
             case 'n': {
@@ -609,15 +849,58 @@ static int do_scanf(H &handler, const char *fmt, __gnuc_va_list args) {
                     *typed_dest = handler.num_consumed;
                 continue;
             }
+            default:
+                mlibc::infoLogger() << "\e[31mmlibc: Unknown scanf conversion '"
+                        << *fmt << "'\e[39m" << frg::endlog;
+                __ensure(!"Illegal scanf conversion");
         }
+        // A conversion that matches nothing ends the scan.
+        if (handler.num_consumed == consumed_before)
+            return match_count;
         if (dest) match_count++;
     }
     return match_count;
 }
 
+// Handler for do_scanf() that operates directly on the buffer of a FILE.
+// Only refills go through abstract_file::read(); the character that triggered
+// the refill is pushed back so that it is still available for look_ahead().
+struct StreamScanner {
+	StreamScanner(FILE *stream)
+	: file{static_cast<mlibc::abstract_file *>(stream)}, num_consumed{0} { }
+
+	char look_ahead() {
+		if(file->__offset < file->__valid_limit)
+			return file->__buffer_ptr[file->__offset];
+
+		char c;
+		size_t actual_size;
+		if(file->read(&c, 1, &actual_size) || !actual_size)
+			return 0;
+		if(file->unget(c))
+			__ensure(!"unget() after read() cannot fail");
+		return c;
+	}
+
+	char consume() {
+		char c = look_ahead();
+		if(file->__offset < file->__valid_limit) {
+			file->__offset++;
+			num_consumed++;
+		}
+		return c;
+	}
+
+	mlibc::abstract_file *file;
+	int num_consumed;
+};
+
 int scanf(const char *__restrict format, ...) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
+	va_list args;
+	va_start(args, format);
+	int result = vfscanf(stdin, format, args);
+	va_end(args);
+	return result;
 }
 int snprintf(char *__restrict buffer, size_t max_size, const char *__restrict format, ...) {
 	va_list args;
@@ -634,25 +917,11 @@ int sprintf(char *__restrict buffer, const char *__restrict format, ...) {
 	return result;
 }
 int sscanf(const char *__restrict buffer, const char *__restrict format, ...) {
-    class {
-    public:
-        char look_ahead() {
-            return *buffer;
-        }
-
-        char consume() {
-            num_consumed++;
-            return *buffer++;
-        }
-
-        const char *buffer;
-        int num_consumed;
-    } handler = {buffer};
-    va_list args;
-    va_start(args, format);
-    int result = do_scanf(handler, format, args);
-    va_end(args);
-    return result;
+	va_list args;
+	va_start(args, format);
+	int result = vsscanf(buffer, format, args);
+	va_end(args);
+	return result;
 }
 int vfprintf(FILE *__restrict stream, const char *__restrict format, __gnuc_va_list args) {
 	frg::va_struct vs;
@@ -660,29 +929,29 @@ int vfprintf(FILE *__restrict stream, const char *__restrict format, __gnuc_va_l
 	StreamPrinter p{stream};
 //	mlibc::infoLogger() << "printf(" << format << ")" << frg::endlog;
 	frg::printf_format(PrintfAgent{&p, &vs}, format, &vs);
+	p.flush();
 	return p.count;
 }
 int vfscanf(FILE *__restrict stream, const char *__restrict format, __gnuc_va_list args) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
+	StreamScanner handler{stream};
+	return do_scanf(handler, format, args);
 }
 int vprintf(const char *__restrict format, __gnuc_va_list args){
 	return vfprintf(stdout, format, args);
 }
 int vscanf(const char *__restrict format, __gnuc_va_list args) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
+	return vfscanf(stdin, format, args);
 }
 int vsnprintf(char *__restrict buffer, size_t max_size,
 		const char *__restrict format, __gnuc_va_list args) {
-	if(!max_size)
-		return 0;
 	frg::va_struct vs;
 	va_copy(vs.args, args);
-	LimitedPrinter p{buffer, max_size - 1};
+	// Even if nothing is written, we need to report the length of the output.
+	LimitedPrinter p{buffer, max_size ? max_size - 1 : 0};
 //	mlibc::infoLogger() << "printf(" << format << ")" << frg::endlog;
 	frg::printf_format(PrintfAgent{&p, &vs}, format, &vs);
-	p.buffer[frg::min(max_size - 1, p.count)] = 0;
+	if(max_size)
+		p.buffer[frg::min(max_size - 1, p.count)] = 0;
 	return p.count;
 }
 int vsprintf(char *__restrict buffer, const char *__restrict format, __gnuc_va_list args) {
@@ -695,27 +964,174 @@ int vsprintf(char *__restrict buffer, const char *__restrict format, __gnuc_va_l
 	return p.count;
 }
 int vsscanf(const char *__restrict buffer, const char *__restrict format, __gnuc_va_list args) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
+    class {
+    public:
+        char look_ahead() {
+            return *buffer;
+        }
+
+        char consume() {
+            if (!*buffer)
+                return 0;
+            num_consumed++;
+            return *buffer++;
+        }
+
+        const char *buffer;
+        int num_consumed;
+    } handler = {buffer};
+    return do_scanf(handler, format, args);
+}
+
+namespace {
+
+// The wide printf() functions convert the format string to the current charcode,
+// format it like printf() and decode the result. The conversions behave like
+// their wide counterparts: %s and %c take multibyte strings and characters,
+// %ls and %lc take wide strings and characters.
+
+// Returns a malloc()ed copy of the format in the current charcode.
+char *narrow_format(const wchar_t *format) {
+	char units[MB_CUR_MAX];
+	size_t length = 0;
+	for(size_t i = 0; format[i]; i++) {
+		int n = encode_wide_char(format[i], units);
+		if(n < 0) {
+			errno = EILSEQ;
+			return nullptr;
+		}
+		length += n;
+	}
+
+	auto narrow = static_cast<char *>(malloc(length + 1));
+	if(!narrow) {
+		errno = ENOMEM;
+		return nullptr;
+	}
+	size_t k = 0;
+	for(size_t i = 0; format[i]; i++)
+		k += encode_wide_char(format[i], narrow + k);
+	narrow[k] = 0;
+	return narrow;
+}
+
+// Formats into a malloc()ed buffer. Returns the number of code units or -1.
+int format_wide(char **out, const wchar_t *format, __gnuc_va_list args) {
+	char *narrow = narrow_format(format);
+	if(!narrow)
+		return -1;
+	int length = vasprintf(out, narrow, args);
+	free(narrow);
+	return length;
+}
+
+} // anonymous namespace
+
+int fwprintf(FILE *__restrict stream, const wchar_t *__restrict format, ...) {
+	va_list args;
+	va_start(args, format);
+	int result = vfwprintf(stream, format, args);
+	va_end(args);
+	return result;
 }
 
-int fwprintf(FILE *__restrict, const wchar_t *__restrict, ...) MLIBC_STUB_BODY
 int fwscanf(FILE *__restrict, const wchar_t *__restrict, ...) MLIBC_STUB_BODY
-int vfwprintf(FILE *__restrict, const wchar_t *__restrict, __gnuc_va_list) MLIBC_STUB_BODY
+
+int vfwprintf(FILE *__restrict stream, const wchar_t *__restrict format, __gnuc_va_list args) {
+	auto file = static_cast<mlibc::abstract_file *>(stream);
+	file->orient(1);
+
+	char *out;
+	int length = format_wide(&out, format, args);
+	if(length < 0)
+		return -1;
+
+	// We return the number of wide characters, not the number of code units.
+	size_t count = 0;
+	mlibc::code_seq<const char> nseq{out, out + length};
+	while(nseq) {
+		wchar_t scratch[64];
+		mlibc::code_seq<wchar_t> wseq{scratch, scratch + 64};
+		if(widen(nseq, wseq) != mlibc::charcode_error::null) {
+			free(out);
+			errno = EILSEQ;
+			return -1;
+		}
+		count += wseq.it - scratch;
+	}
+
+	if(length && fwrite_unlocked(out, 1, length, stream) != size_t(length)) {
+		free(out);
+		return -1;
+	}
+	free(out);
+	return count;
+}
+
 int vfwscanf(FILE *__restrict, const wchar_t *__restrict, __gnuc_va_list) MLIBC_STUB_BODY
 
-int swprintf(wchar_t *__restrict, size_t, const wchar_t *__restrict, ...) MLIBC_STUB_BODY
+int swprintf(wchar_t *__restrict buffer, size_t max_size, const wchar_t *__restrict format, ...) {
+	va_list args;
+	va_start(args, format);
+	int result = vswprintf(buffer, max_size, format, args);
+	va_end(args);
+	return result;
+}
+
 int swscanf(wchar_t *__restrict, size_t, const wchar_t *__restrict, ...) MLIBC_STUB_BODY
-int vswprintf(wchar_t *__restrict, size_t, const wchar_t *__restrict, __gnuc_va_list) MLIBC_STUB_BODY
+
+int vswprintf(wchar_t *__restrict buffer, size_t max_size, const wchar_t *__restrict format,
+		__gnuc_va_list args) {
+	if(!max_size) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	char *out;
+	int length = format_wide(&out, format, args);
+	if(length < 0) {
+		buffer[0] = 0;
+		return -1;
+	}
+
+	mlibc::code_seq<const char> nseq{out, out + length};
+	mlibc::code_seq<wchar_t> wseq{buffer, buffer + max_size - 1};
+	auto e = widen(nseq, wseq);
+	*wseq.it = 0;
+	free(out);
+	if(e != mlibc::charcode_error::null) {
+		errno = EILSEQ;
+		return -1;
+	}
+	// Unlike snprintf(), we fail if the output is truncated.
+	if(nseq.it != nseq.end) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+	return wseq.it - buffer;
+}
+
 int vswscanf(wchar_t *__restrict, size_t, const wchar_t *__restrict, __gnuc_va_list) MLIBC_STUB_BODY
 
-int wprintf(const wchar_t *__restrict, ...) MLIBC_STUB_BODY
+int wprintf(const wchar_t *__restrict format, ...) {
+	va_list args;
+	va_start(args, format);
+	int result = vfwprintf(stdout, format, args);
+	va_end(args);
+	return result;
+}
+
 int wscanf(const wchar_t *__restrict, ...) MLIBC_STUB_BODY
-int vwprintf(const wchar_t *__restrict, __gnuc_va_list) MLIBC_STUB_BODY
+
+int vwprintf(const wchar_t *__restrict format, __gnuc_va_list args) {
+	return vfwprintf(stdout, format, args);
+}
+
 int vwscanf(const wchar_t *__restrict, __gnuc_va_list) MLIBC_STUB_BODY
 
 int fgetc(FILE *stream) {
-	char c;
+	// The byte must not be sign-extended, otherwise 0xFF is indistinguishable from EOF.
+	unsigned char c;
 	auto bytes_read = fread(&c, 1, 1, stream);
 	if(bytes_read != 1)
 		return EOF;
@@ -838,16 +1254,198 @@ int puts(const char *string) {
 	return 1;
 }
 
-wint_t fgetwc(FILE *) MLIBC_STUB_BODY
-wchar_t *fgetws(wchar_t *__restrict, int, FILE *__restrict) MLIBC_STUB_BODY
-wint_t fputwc(wchar_t, FILE *) MLIBC_STUB_BODY
-int fputws(const wchar_t *__restrict, FILE *__restrict) MLIBC_STUB_BODY
-int fwide(FILE *, int) MLIBC_STUB_BODY
-wint_t getwc(FILE *) MLIBC_STUB_BODY
-wint_t getwchar(void) MLIBC_STUB_BODY
-wint_t putwc(wchar_t, FILE *) MLIBC_STUB_BODY
-wint_t putwchar(wchar_t) MLIBC_STUB_BODY
-wint_t ungetwc(wint_t, FILE *) MLIBC_STUB_BODY
+wint_t fgetwc(FILE *stream) {
+	auto file = static_cast<mlibc::abstract_file *>(stream);
+	file->orient(1);
+	auto cc = mlibc::current_charcode();
+
+	// Fast path: ASCII characters that are already buffered.
+	if(cc->preserves_7bit_units && file->__offset < file->__valid_limit) {
+		auto uc = static_cast<unsigned char>(file->__buffer_ptr[file->__offset]);
+		if(uc < 0x80) {
+			file->__offset++;
+			return uc;
+		}
+	}
+
+	// Read code units until they form a complete character.
+	char units[MB_CUR_MAX];
+	int n = 0;
+	while(true) {
+		int c = fgetc_unlocked(stream);
+		if(c == EOF) {
+			if(!n)
+				return WEOF;
+			// The stream ends in the middle of a character.
+			errno = EILSEQ;
+			file->__status_bits |= __MLIBC_ERROR_BIT;
+			return WEOF;
+		}
+		units[n++] = c;
+
+		wchar_t wc;
+		__mlibc_mbstate st = __MLIBC_MBSTATE_INITIALIZER;
+		mlibc::code_seq<const char> nseq{units, units + n};
+		mlibc::code_seq<wchar_t> wseq{&wc, &wc + 1};
+		auto e = cc->decode_wtranscode(nseq, wseq, st);
+		if(e == mlibc::charcode_error::input_underflow && n < MB_CUR_MAX)
+			continue;
+		if(e != mlibc::charcode_error::null) {
+			errno = EILSEQ;
+			file->__status_bits |= __MLIBC_ERROR_BIT;
+			return WEOF;
+		}
+		if(wseq.it == &wc) // The charcode does not produce null characters.
+			return 0;
+		return wc;
+	}
+}
+
+wchar_t *fgetws(wchar_t *__restrict buffer, int max_size, FILE *__restrict stream) {
+	auto file = static_cast<mlibc::abstract_file *>(stream);
+	file->orient(1);
+	auto cc = mlibc::current_charcode();
+	if(max_size <= 0)
+		return nullptr;
+
+	int i = 0;
+	while(i < max_size - 1) {
+		// Convert the run of buffered ASCII characters at once.
+		if(cc->preserves_7bit_units && file->__offset < file->__valid_limit) {
+			auto p = reinterpret_cast<unsigned char *>(file->__buffer_ptr) + file->__offset;
+			size_t limit = file->__valid_limit - file->__offset;
+			if(limit > size_t(max_size - 1 - i))
+				limit = max_size - 1 - i;
+
+			size_t k = 0;
+			bool newline = false;
+			while(k < limit && p[k] < 0x80) {
+				buffer[i + k] = p[k];
+				if(p[k++] == '\n') {
+					newline = true;
+					break;
+				}
+			}
+			file->__offset += k;
+			i += k;
+			if(newline)
+				break;
+			if(k)
+				continue;
+		}
+
+		// The buffer is empty or starts with a non-ASCII character.
+		wint_t wc = fgetwc(stream);
+		if(wc == WEOF) {
+			if(!i || ferror(stream))
+				return nullptr;
+			break;
+		}
+		buffer[i++] = wc;
+		if(wc == L'\n')
+			break;
+	}
+	buffer[i] = 0;
+	return buffer;
+}
+
+wint_t fputwc(wchar_t wc, FILE *stream) {
+	auto file = static_cast<mlibc::abstract_file *>(stream);
+	file->orient(1);
+
+	char units[MB_CUR_MAX];
+	int n = encode_wide_char(wc, units);
+	if(n < 0) {
+		errno = EILSEQ;
+		file->__status_bits |= __MLIBC_ERROR_BIT;
+		return WEOF;
+	}
+	if(fwrite_unlocked(units, 1, n, stream) != size_t(n))
+		return WEOF;
+	return wc;
+}
+
+int fputws(const wchar_t *__restrict string, FILE *__restrict stream) {
+	auto file = static_cast<mlibc::abstract_file *>(stream);
+	file->orient(1);
+	auto cc = mlibc::current_charcode();
+
+	// Encode into a local buffer such that runs of characters are written at once.
+	char chunk[256];
+	size_t n = 0;
+	auto flush_chunk = [&] {
+		if(n && fwrite_unlocked(chunk, 1, n, stream) != n)
+			return false;
+		n = 0;
+		return true;
+	};
+
+	for(size_t i = 0; string[i]; ) {
+		if(n + MB_CUR_MAX > sizeof(chunk) && !flush_chunk())
+			return EOF;
+
+		if(cc->preserves_7bit_units) {
+			while(string[i] && static_cast<uint32_t>(string[i]) < 0x80 && n < sizeof(chunk))
+				chunk[n++] = string[i++];
+			if(!string[i] || n + MB_CUR_MAX > sizeof(chunk))
+				continue;
+		}
+
+		int k = encode_wide_char(string[i], chunk + n);
+		if(k < 0) {
+			flush_chunk();
+			errno = EILSEQ;
+			file->__status_bits |= __MLIBC_ERROR_BIT;
+			return EOF;
+		}
+		n += k;
+		i++;
+	}
+	if(!flush_chunk())
+		return EOF;
+	return 1;
+}
+
+int fwide(FILE *stream, int mode) {
+	auto file = static_cast<mlibc::abstract_file *>(stream);
+	return file->orient(mode);
+}
+
+wint_t getwc(FILE *stream) {
+	return fgetwc(stream);
+}
+
+wint_t getwchar(void) {
+	return fgetwc(stdin);
+}
+
+wint_t putwc(wchar_t wc, FILE *stream) {
+	return fputwc(wc, stream);
+}
+
+wint_t putwchar(wchar_t wc) {
+	return fputwc(wc, stdout);
+}
+
+wint_t ungetwc(wint_t wc, FILE *stream) {
+	if(wc == WEOF)
+		return WEOF;
+
+	auto file = static_cast<mlibc::abstract_file *>(stream);
+	file->orient(1);
+
+	char units[MB_CUR_MAX];
+	int n = encode_wide_char(wc, units);
+	if(n < 0)
+		return WEOF;
+	// Push back the code units in reverse order.
+	for(int i = n - 1; i >= 0; i--) {
+		if(file->unget(units[i]))
+			return WEOF;
+	}
+	stream->__status_bits &= ~__MLIBC_EOF_BIT;
+	return wc;
+}
 
 size_t fread(void *buffer, size_t size, size_t count, FILE *file_base) {
 	return fread_unlocked(buffer, size, count, file_base);
@@ -882,10 +1480,13 @@ int ferror(FILE *file_base) {
 
 int perror(const char *string) {
 	int error = errno;
+	// Emit the message using a single fprintf() such that it is written at once.
 	if (string && *string) {
-		fprintf(stderr, "%s: ", string);
+		fprintf(stderr, "%s: %s\n", string, strerror(error));
+	}else{
+		fprintf(stderr, "%s\n", strerror(error));
 	}
-	fprintf(stderr, "%s\n", strerror(error));
+	return 0;
 }
 
 // POSIX unlocked I/O extensions.
@@ -3,7 +3,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
+#include <math.h>
 
 #include <frg/random.hpp>
 #include <mlibc/debug.hpp>
@@ -11,6 +13,7 @@
 
 #include <mlibc/allocator.hpp>
 #include <mlibc/charcode.hpp>
+#include <mlibc/float-format.hpp>
 #include <mlibc/sysdeps.hpp>
 
 extern "C" int __cxa_atexit(void (*function)(void *), void *argument, void *dso_tag);
@@ -36,32 +39,311 @@ long atol(const char *string) {
 long long atoll(const char *string) {
 	return strtoll(string, nullptr, 10);
 }
-double strtod(const char *__restrict string, char **__restrict end) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
-}
-float strtof(const char *__restrict string, char **__restrict end) {
-	mlibc::infoLogger() << "mlibc: strtof() called on string '" << string << "'" << frg::endlog;
+namespace {
+	template<typename T>
+	struct float_traits;
+
+	// T(m) * 2^e with m < 2^mantissa_bits is exact for min_exponent <= e <= max_exponent.
+	// Powers of ten up to 10^max_exact_pow10 are exact in T.
+	template<>
+	struct float_traits<float> {
+		static constexpr bool rounds_correctly = true;
+		static constexpr int mantissa_bits = __FLT_MANT_DIG__;
+		static constexpr int min_exponent = __FLT_MIN_EXP__ - __FLT_MANT_DIG__;
+		static constexpr int max_exponent = __FLT_MAX_EXP__ - __FLT_MANT_DIG__;
+		static constexpr int max_exact_pow10 = 10;
+	};
+
+	template<>
+	struct float_traits<double> {
+		static constexpr bool rounds_correctly = true;
+		static constexpr int mantissa_bits = __DBL_MANT_DIG__;
+		static constexpr int min_exponent = __DBL_MIN_EXP__ - __DBL_MANT_DIG__;
+		static constexpr int max_exponent = __DBL_MAX_EXP__ - __DBL_MANT_DIG__;
+		static constexpr int max_exact_pow10 = 22;
+	};
+
+	// round_decimal() needs one bit more than the mantissa of T (for the midpoints).
+	// For long double, that does not fit into 64 bits; it is only approximated.
+	template<>
+	struct float_traits<long double> {
+		static constexpr bool rounds_correctly = false;
+	};
+
+	constexpr double exact_pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	// Compares 0.S * 10^exponent with the (non-zero) decimal d. S are the digits in
+	// [begin, end), without the decimal point; the first one is not zero.
+	int compare_decimal(const char *begin, const char *end, int exponent,
+			const mlibc::float_digits &d) {
+		if(exponent != d.exponent)
+			return exponent < d.exponent ? -1 : 1;
+		int i = 0;
+		for(auto p = begin; p != end; p++) {
+			if(*p == '.')
+				continue;
+			char digit = i < d.length ? d.digits[i] : '0';
+			if(*p != digit)
+				return *p < digit ? -1 : 1;
+			i++;
+		}
+		// d does not store trailing zeros, hence, any remaining digit makes it larger.
+		return i < d.length ? -1 : 0;
+	}
+
+	// Rounds 0.S * 10^exponent (see compare_decimal()) correctly to T, starting from an
+	// approximation that is off by at most a few ulps. To decide in which direction
+	// to round, the input is compared with the exact decimal expansion of the midpoints
+	// between adjacent values of T.
+	template<typename T>
+	T round_decimal(long double approximation, const char *begin, const char *end,
+			int exponent) {
+		using traits = float_traits<T>;
+		constexpr uint64_t hidden = uint64_t(1) << (traits::mantissa_bits - 1);
+
+		// Decompose the approximation into m * 2^e.
+		T candidate = approximation;
+		uint64_t m;
+		int e;
+		if(__builtin_isinf(candidate)) {
+			m = 2 * hidden - 1;
+			e = traits::max_exponent;
+		}else if(!candidate) {
+			m = 0;
+			e = traits::min_exponent;
+		}else{
+			int k;
+			m = scalbnl(frexpl(candidate, &k), traits::mantissa_bits);
+			e = k - traits::mantissa_bits;
+			if(e < traits::min_exponent) {
+				m >>= traits::min_exponent - e;
+				e = traits::min_exponent;
+			}
+		}
 
-	const char *s = string;
-	char *e;
-	long integral;
-	long fractional;
+		mlibc::float_digits d;
+		while(true) {
+			mlibc::binary_to_decimal(2 * m + 1, e - 1, d);
+			int c = compare_decimal(begin, end, exponent, d);
+			if(c > 0 || (!c && (m & 1))) {
+				if(++m == 2 * hidden) {
+					m = hidden;
+					e++;
+				}
+				if(e > traits::max_exponent)
+					return __builtin_inf();
+				continue;
+			}
+			if(!m)
+				break;
+
+			// Below powers of two, the values of T are closer together.
+			bool closer = m == hidden && e > traits::min_exponent;
+			if(closer) {
+				mlibc::binary_to_decimal(4 * m - 1, e - 2, d);
+			}else{
+				mlibc::binary_to_decimal(2 * m - 1, e - 1, d);
+			}
+			c = compare_decimal(begin, end, exponent, d);
+			if(c < 0 || (!c && (m & 1))) {
+				if(closer) {
+					m = 2 * hidden - 1;
+					e--;
+				}else{
+					m--;
+				}
+				continue;
+			}
+			break;
+		}
+		return scalbnl(m, e);
+	}
+
+	// Approximates mantissa * 10^exponent. If digits were dropped from the mantissa,
+	// first_dropped is the first of them (and -1 otherwise).
+	long double approximate_decimal(uint64_t mantissa, int first_dropped, int exponent) {
+		if(first_dropped >= 5)
+			mantissa++;
+		if(exponent > 5000)
+			return __builtin_infl();
+		if(exponent < -5000)
+			return 0;
+
+		long double scale = 1;
+		long double power = 10;
+		for(int n = exponent < 0 ? -exponent : exponent; n; n >>= 1) {
+			if(n & 1)
+				scale *= power;
+			power *= power;
+		}
+		return exponent < 0 ? mantissa / scale : mantissa * scale;
+	}
 
-	integral = strtol(s, &e, 10);
-	__ensure(*e == '.');
-	s = e + 1;
-	fractional = strtol(s, &e, 10);
+	// Parses the subject sequence of strtod() and friends.
+	// The first significant digits are collected in a 64-bit integer. If that integer and
+	// the power of ten are exact in T, a single operation in T rounds correctly.
+	// Otherwise, the value is approximated in long double and float and double results
+	// are rounded correctly by round_decimal(). For long double, the approximation is
+	// the result; it may be off by an ulp if the input has more than 19 significant
+	// digits or a large exponent.
+	template<typename T>
+	T parse_float(const char *string, char **end) {
+		auto s = string;
+		while(isspace(*s))
+			s++;
+
+		bool negative = false;
+		if(*s == '+' || *s == '-') {
+			negative = *s == '-';
+			s++;
+		}
 
-	if(end)
-		*end = e;
+		auto finish = [&] (const char *tail, T value) -> T {
+			if(end)
+				*end = const_cast<char *>(tail);
+			return negative ? -value : value;
+		};
+
+		if(!strncasecmp(s, "inf", 3)) {
+			s += 3;
+			if(!strncasecmp(s, "inity", 5))
+				s += 5;
+			return finish(s, __builtin_inf());
+		}
+		if(!strncasecmp(s, "nan", 3)) {
+			s += 3;
+			// Skip an optional n-char-sequence in parentheses.
+			if(*s == '(') {
+				auto p = s + 1;
+				while(isalnum(*p) || *p == '_')
+					p++;
+				if(*p == ')')
+					s = p + 1;
+			}
+			return finish(s, __builtin_nan(""));
+		}
+
+		bool hex = s[0] == '0' && (s[1] == 'x' || s[1] == 'X')
+				&& (isxdigit(s[2]) || (s[2] == '.' && isxdigit(s[3])));
+		if(hex)
+			s += 2;
+		uint64_t radix = hex ? 16 : 10;
+		auto digit_value = [&] (char c) -> int {
+			if(isdigit(c))
+				return c - '0';
+			if(hex && isxdigit(c))
+				return (c | 0x20) - 'a' + 10;
+			return -1;
+		};
+
+		// Only the first digits fit into the mantissa; the remaining ones only affect
+		// the exponent (and the rounding of the mantissa). The value is
+		// mantissa * radix^exponent (approximately, if digits were dropped)
+		// and 0.S * 10^point_exponent, where S starts at significant.
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int point_exponent = 0;
+		const char *significant = nullptr;
+		bool have_digits = false;
+		bool after_point = false;
+		int first_dropped = -1;
+		bool inexact = false;
+		for(;; s++) {
+			if(*s == '.' && !after_point) {
+				after_point = true;
+				continue;
+			}
+			int d = digit_value(*s);
+			if(d < 0)
+				break;
+			have_digits = true;
+			if(d && !significant)
+				significant = s;
+			if(significant && !after_point)
+				point_exponent++;
+			else if(!significant && after_point)
+				point_exponent--;
+
+			if(mantissa <= (UINT64_MAX - 15) / radix) {
+				mantissa = mantissa * radix + d;
+				if(after_point)
+					exponent--;
+			}else{
+				if(first_dropped < 0)
+					first_dropped = d;
+				else if(d)
+					inexact = true;
+				if(!after_point)
+					exponent++;
+			}
+		}
+		if(!have_digits)
+			return finish(string, 0);
+		auto digits_end = s;
+
+		// Hexadecimal exponents are binary; the digits scale by four bits each.
+		if(hex)
+			exponent *= 4;
+
+		if((hex && (*s == 'p' || *s == 'P')) || (!hex && (*s == 'e' || *s == 'E'))) {
+			auto p = s + 1;
+			bool negative_exponent = false;
+			if(*p == '+' || *p == '-') {
+				negative_exponent = *p == '-';
+				p++;
+			}
+			if(isdigit(*p)) {
+				int value = 0;
+				for(; isdigit(*p); p++) {
+					if(value < 100000)
+						value = value * 10 + (*p - '0');
+				}
+				exponent += negative_exponent ? -value : value;
+				point_exponent += negative_exponent ? -value : value;
+				s = p;
+			}
+		}
+
+		if(!significant)
+			return finish(s, 0);
+
+		T result;
+		if(hex) {
+			// Keep dropped bits sticky such that the result is rounded correctly.
+			if(first_dropped > 0 || inexact)
+				mantissa |= 1;
+			result = scalbnl(mantissa, exponent);
+		}else if constexpr (!float_traits<T>::rounds_correctly) {
+			result = approximate_decimal(mantissa, first_dropped, exponent);
+		}else{
+			using traits = float_traits<T>;
+			int k = exponent < 0 ? -exponent : exponent;
+			if(first_dropped < 0 && mantissa <= (uint64_t(1) << traits::mantissa_bits)
+					&& k <= traits::max_exact_pow10) {
+				auto power = static_cast<T>(exact_pow10[k]);
+				result = exponent < 0 ? T(mantissa) / power : T(mantissa) * power;
+			}else{
+				result = round_decimal<T>(approximate_decimal(mantissa, first_dropped, exponent),
+						significant, digits_end, point_exponent);
+			}
+		}
 
-	__ensure(!fractional);
-	return integral;
+		if(__builtin_isinf(result) || !result)
+			errno = ERANGE;
+		return finish(s, result);
+	}
+}
+double strtod(const char *__restrict string, char **__restrict end) {
+	return parse_float<double>(string, end);
+}
+float strtof(const char *__restrict string, char **__restrict end) {
+	return parse_float<float>(string, end);
 }
 long double strtold(const char *__restrict string, char **__restrict end) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
+	return parse_float<long double>(string, end);
 }
 long strtol(const char *__restrict string, char **__restrict end, int base) {
 //	mlibc::infoLogger() << "mlibc: strtol() called on string '" << string << "'" << frg::endlog;
@@ -262,26 +544,297 @@ void *bsearch(const void *key, const void *base, size_t count, size_t size,
 
 	return nullptr;
 }
-void qsort(void *base, size_t count, size_t size,
-		int (*compare)(const void *, const void *)) {
-	// TODO: implement a faster sort
-	for(size_t i = 0; i < count; i++) {
-		void *u = (void *)((uintptr_t)base + i * size);
-		for(size_t j = i + 1; j < count; j++) {
-			void *v = (void *)((uintptr_t)base + j * size);
-			if(compare(u, v) <= 0)
-				continue;
+namespace {
+	// Swaps elements of a size that is known at compile time.
+	template<size_t Size>
+	struct fixed_swap {
+		void operator() (char *a, char *b) const {
+			char t[Size];
+			__builtin_memcpy(t, a, Size);
+			__builtin_memcpy(a, b, Size);
+			__builtin_memcpy(b, t, Size);
+		}
+	};
+
+	// Swaps aligned elements whose size is a multiple of the word size.
+	struct word_swap {
+		void operator() (char *a, char *b) const {
+			auto x = reinterpret_cast<size_t *>(a);
+			auto y = reinterpret_cast<size_t *>(b);
+			for(size_t i = 0; i < words; i++) {
+				size_t t = x[i];
+				x[i] = y[i];
+				y[i] = t;
+			}
+		}
+
+		size_t words;
+	};
+
+	struct byte_swap {
+		void operator() (char *a, char *b) const {
+			for(size_t i = 0; i < size; i++) {
+				char t = a[i];
+				a[i] = b[i];
+				b[i] = t;
+			}
+		}
+
+		size_t size;
+	};
+
+	// Pattern-defeating quicksort (an introsort variant, see Orson Peters' pdqsort):
+	// - Partitions that are small enough are insertion sorted.
+	// - If the pivot equals the element before the partition, all elements that equal
+	//   the pivot are moved to the left; they do not need to be sorted further.
+	// - If a partition did not require any swaps, it is likely sorted already;
+	//   we try to insertion sort it but give up after a few moves.
+	// - Unbalanced partitions shuffle a few elements to break up patterns. After too many
+	//   unbalanced partitions, we fall back to heapsort to guarantee O(n log n).
+	template<typename Swap, typename Compare>
+	struct sorter {
+		static constexpr size_t insertion_threshold = 16;
+		static constexpr size_t ninther_threshold = 128;
+		static constexpr size_t partial_insertion_limit = 8;
+
+		char *at(char *first, size_t i) {
+			return first + i * size;
+		}
+
+		bool less(char *first, size_t i, size_t j) {
+			return compare(at(first, i), at(first, j)) < 0;
+		}
+
+		void swap_at(char *first, size_t i, size_t j) {
+			swap(at(first, i), at(first, j));
+		}
+
+		void insertion_sort(char *first, size_t n) {
+			for(size_t i = 1; i < n; i++) {
+				for(size_t j = i; j > 0 && less(first, j, j - 1); j--)
+					swap_at(first, j, j - 1);
+			}
+		}
+
+		// Returns false if more than partial_insertion_limit moves would be needed.
+		bool partial_insertion_sort(char *first, size_t n) {
+			size_t moves = 0;
+			for(size_t i = 1; i < n; i++) {
+				for(size_t j = i; j > 0 && less(first, j, j - 1); j--) {
+					swap_at(first, j, j - 1);
+					moves++;
+				}
+				if(moves > partial_insertion_limit)
+					return false;
+			}
+			return true;
+		}
+
+		void sift_down(char *first, size_t n, size_t i) {
+			while(true) {
+				size_t child = 2 * i + 1;
+				if(child >= n)
+					return;
+				if(child + 1 < n && less(first, child, child + 1))
+					child++;
+				if(!less(first, i, child))
+					return;
+				swap_at(first, i, child);
+				i = child;
+			}
+		}
+
+		void heap_sort(char *first, size_t n) {
+			for(size_t i = n / 2; i > 0; i--)
+				sift_down(first, n, i - 1);
+			for(size_t k = n - 1; k > 0; k--) {
+				swap_at(first, 0, k);
+				sift_down(first, k, 0);
+			}
+		}
 
-			// swap u and v
-			char *u_bytes = (char *)u;
-			char *v_bytes = (char *)v;
-			for(size_t k = 0; k < size; k++) {
-				char temp = u_bytes[k];
-				u_bytes[k] = v_bytes[k];
-				v_bytes[k] = temp;
+		// Orders the elements at i, j and k.
+		void sort3(char *first, size_t i, size_t j, size_t k) {
+			if(less(first, j, i))
+				swap_at(first, i, j);
+			if(less(first, k, j)) {
+				swap_at(first, j, k);
+				if(less(first, j, i))
+					swap_at(first, i, j);
 			}
 		}
+
+		// Partitions around the pivot at index 0: elements less than the pivot go left,
+		// all other elements go right. Returns the final position of the pivot.
+		size_t partition_right(char *first, size_t n, bool &already_partitioned) {
+			size_t i = 1;
+			size_t j = n - 1;
+			while(i < n && less(first, i, 0))
+				i++;
+			while(j >= i && !less(first, j, 0))
+				j--;
+			already_partitioned = i > j;
+
+			// From here on, the swapped elements stop the scans.
+			while(i < j) {
+				swap_at(first, i, j);
+				do {
+					i++;
+				} while(less(first, i, 0));
+				do {
+					j--;
+				} while(!less(first, j, 0));
+			}
+			swap_at(first, 0, i - 1);
+			return i - 1;
+		}
+
+		// Same as partition_right() but elements that equal the pivot go left.
+		size_t partition_left(char *first, size_t n) {
+			size_t i = 1;
+			size_t j = n - 1;
+			while(j > 0 && less(first, 0, j))
+				j--;
+			while(i <= j && !less(first, 0, i))
+				i++;
+
+			while(i < j) {
+				swap_at(first, i, j);
+				do {
+					j--;
+				} while(less(first, 0, j));
+				do {
+					i++;
+				} while(!less(first, 0, i));
+			}
+			swap_at(first, 0, j);
+			return j;
+		}
+
+		void sort(char *first, size_t n, int bad_allowed, bool leftmost) {
+			while(true) {
+				if(n <= insertion_threshold) {
+					insertion_sort(first, n);
+					return;
+				}
+
+				// Move the pivot to index 0.
+				size_t mid = n / 2;
+				if(n > ninther_threshold) {
+					sort3(first, 0, mid, n - 1);
+					sort3(first, 1, mid - 1, n - 2);
+					sort3(first, 2, mid + 1, n - 3);
+					sort3(first, mid - 1, mid, mid + 1);
+					swap_at(first, 0, mid);
+				}else{
+					sort3(first, mid, 0, n - 1);
+				}
+
+				// The element before a partition that is not leftmost is not greater than any
+				// element of the partition. If it is not less than the pivot, it equals the pivot.
+				if(!leftmost && !(compare(first - size, first) < 0)) {
+					size_t p = partition_left(first, n);
+					first = at(first, p + 1);
+					n -= p + 1;
+					continue;
+				}
+
+				bool already_partitioned;
+				size_t p = partition_right(first, n, already_partitioned);
+				size_t l = p;
+				size_t r = n - p - 1;
+
+				if(l < n / 8 || r < n / 8) {
+					if(!--bad_allowed) {
+						heap_sort(first, n);
+						return;
+					}
+					if(l >= insertion_threshold) {
+						swap_at(first, 0, l / 4);
+						swap_at(first, p - 1, p - l / 4);
+					}
+					if(r >= insertion_threshold) {
+						swap_at(first, p + 1, p + 1 + r / 4);
+						swap_at(first, n - 1, n - r / 4);
+					}
+				}else if(already_partitioned
+						&& partial_insertion_sort(first, l)
+						&& partial_insertion_sort(at(first, p + 1), r)) {
+					return;
+				}
+
+				// Recurse into the smaller partition to bound the stack depth.
+				if(l < r) {
+					sort(first, l, bad_allowed, leftmost);
+					first = at(first, p + 1);
+					n = r;
+					leftmost = false;
+				}else{
+					sort(at(first, p + 1), r, bad_allowed, false);
+					n = l;
+				}
+			}
+		}
+
+		size_t size;
+		Swap swap;
+		Compare compare;
+	};
+
+	template<typename Compare>
+	void sort_elements(void *base, size_t count, size_t size, Compare compare) {
+		if(count < 2 || !size)
+			return;
+		auto first = static_cast<char *>(base);
+
+		int bad_allowed = 1;
+		for(size_t n = count; n > 1; n >>= 1)
+			bad_allowed++;
+
+		auto run = [&] (auto swap) {
+			sorter<decltype(swap), Compare> s{size, swap, compare};
+			s.sort(first, count, bad_allowed, true);
+		};
+		if(size == 4) {
+			run(fixed_swap<4>{});
+		}else if(size == 8) {
+			run(fixed_swap<8>{});
+		}else if(size == 16) {
+			run(fixed_swap<16>{});
+		}else if(!(size % sizeof(size_t))
+				&& !(reinterpret_cast<uintptr_t>(base) & (alignof(size_t) - 1))) {
+			run(word_swap{size / sizeof(size_t)});
+		}else{
+			run(byte_swap{size});
+		}
 	}
+
+	struct plain_compare {
+		int operator() (const void *a, const void *b) const {
+			return fn(a, b);
+		}
+
+		int (*fn)(const void *, const void *);
+	};
+
+	struct compare_with_argument {
+		int operator() (const void *a, const void *b) const {
+			return fn(a, b, arg);
+		}
+
+		int (*fn)(const void *, const void *, void *);
+		void *arg;
+	};
+}
+
+void qsort(void *base, size_t count, size_t size,
+		int (*compare)(const void *, const void *)) {
+	sort_elements(base, count, size, plain_compare{compare});
+}
+
+void qsort_r(void *base, size_t count, size_t size,
+		int (*compare)(const void *, const void *, void *), void *arg) {
+	sort_elements(base, count, size, compare_with_argument{compare, arg});
 }
 
 int abs(int number) {
@@ -4,6 +4,12 @@
 #include <wchar.h>
 
 #include <bits/ensure.h>
+#include <mlibc/byte-compare.hpp>
+#include <mlibc/byte-copy.hpp>
+#include <mlibc/byte-scan.hpp>
+#include <mlibc/byte-set.hpp>
+#include <mlibc/substring-search.hpp>
+#include <mlibc/wide-string.hpp>
 
 // memset() is defined in options/internals.
 // memcpy() is defined in options/internals.
@@ -11,25 +17,13 @@
 // strlen() is defined in options/internals.
 
 char *strcpy(char *__restrict dest, const char *src) {
-	char *dest_bytes = (char *)dest;
-	char *src_bytes = (char *)src;
-	while(*src_bytes)
-		*(dest_bytes++) = *(src_bytes++);
-	*dest_bytes = 0;
+	auto n = mlibc::byte_copy::copy_string(dest, src, SIZE_MAX);
+	dest[n] = 0;
 	return dest;
 }
 char *strncpy(char *__restrict dest, const char *src, size_t max_size) {
-	auto dest_bytes = static_cast<char *>(dest);
-	auto src_bytes = static_cast<const char *>(src);
-	size_t i = 0;
-	while(*src_bytes && i < max_size) {
-		*(dest_bytes++) = *(src_bytes++);
-		i++;
-	}
-	while(i < max_size) {
-		*(dest_bytes++) = 0;
-		i++;
-	}
+	auto n = mlibc::byte_copy::copy_string(dest, src, max_size);
+	memset(dest + n, 0, max_size - n);
 	return dest;
 }
 
@@ -38,43 +32,17 @@ char *strcat(char *__restrict dest, const char *__restrict src) {
 	return dest;
 }
 char *strncat(char *__restrict dest, const char *__restrict src, size_t max_size) {
-	auto dest_bytes = static_cast<char *>(dest);
-	auto src_bytes = static_cast<const char *>(src);
-	dest_bytes += strlen(dest);
-	size_t i = 0;
-	while(*src_bytes && i < max_size) {
-		*(dest_bytes++) = *(src_bytes++);
-		i++;
-	}
-	*dest_bytes = 0;
+	auto dest_bytes = dest + strlen(dest);
+	auto n = mlibc::byte_copy::copy_string(dest_bytes, src, max_size);
+	dest_bytes[n] = 0;
 	return dest;
 }
 
 int memcmp(const void *a, const void *b, size_t size) {
-	for(size_t i = 0; i < size; i++) {
-		auto a_byte = static_cast<const unsigned char *>(a)[i];
-		auto b_byte = static_cast<const unsigned char *>(b)[i];
-		if(a_byte < b_byte)
-			return -1;
-		if(a_byte > b_byte)
-			return 1;
-	}
-	return 0;
+	return mlibc::byte_compare::compare(a, b, size);
 }
 int strcmp(const char *a, const char *b) {
-	size_t i = 0;
-	while(true) {
-		unsigned char a_byte = a[i];
-		unsigned char b_byte = b[i];
-		if(!a_byte && !b_byte)
-			return 0;
-		// If only one char is null, one of the following cases applies.
-		if(a_byte < b_byte)
-			return -1;
-		if(a_byte > b_byte)
-			return 1;
-		i++;
-	}
+	return mlibc::byte_compare::compare_strings(a, b, SIZE_MAX);
 }
 
 int strcoll(const char *a, const char *b) {
@@ -83,21 +51,7 @@ int strcoll(const char *a, const char *b) {
 }
 
 int strncmp(const char *a, const char *b, size_t max_size) {
-	size_t i = 0;
-	while(true) {
-		if(!(i < max_size))
-			return 0;
-		unsigned char a_byte = a[i];
-		unsigned char b_byte = b[i];
-		if(!a_byte && !b_byte)
-			return 0;
-		// If only one char is null, one of the following cases applies.
-		if(a_byte < b_byte)
-			return -1;
-		if(a_byte > b_byte)
-			return 1;
-		i++;
-	}
+	return mlibc::byte_compare::compare_strings(a, b, max_size);
 }
 size_t strxfrm(char *__restrict dest, const char *__restrict src, size_t max_size) {
 	__ensure(!"Not implemented");
@@ -105,88 +59,86 @@ size_t strxfrm(char *__restrict dest, const char *__restrict src, size_t max_siz
 }
 
 void *memchr(const void *s, int c, size_t size) {
-	auto s_bytes = static_cast<const unsigned char *>(s);
-	for(size_t i = 0; i < size; i++)
-		if(s_bytes[i] == static_cast<unsigned char>(c))
-			return const_cast<unsigned char *>(s_bytes + i);
-	return nullptr;
+	auto start = reinterpret_cast<uintptr_t>(s);
+	auto p = mlibc::byte_scan::find_first(start, mlibc::byte_scan::limit_of(s, size), c, false);
+	return reinterpret_cast<void *>(p);
 }
 char *strchr(const char *s, int c) {
-	size_t i = 0;
-	while(s[i]) {
-		if(s[i] == c)
-			return const_cast<char *>(&s[i]);
-		i++;
-	}
-	if(c == 0)
-		return const_cast<char *>(&s[i]);
-	return nullptr;
+	auto start = reinterpret_cast<uintptr_t>(s);
+	auto p = reinterpret_cast<char *>(mlibc::byte_scan::find_first(start, UINTPTR_MAX, c, true));
+	if(*p != static_cast<char>(c))
+		return nullptr;
+	return p;
 }
 size_t strcspn(const char *s, const char *chrs) {
-	size_t n = 0;
-	while(true) {
-		if(!s[n] || strchr(chrs, s[n]))
-			return n;
-		n++;
-	}
+	return mlibc::byte_set::span(s, chrs, false);
 }
 char *strpbrk(const char *s, const char *chrs) {
-	size_t n = 0;
-	while(s[n]) {
-		if(strchr(chrs, s[n]))
-			return const_cast<char *>(s + n);
-		n++;
-	}
-	return nullptr;
+	auto p = s + mlibc::byte_set::span(s, chrs, false);
+	return *p ? const_cast<char *>(p) : nullptr;
 }
 char *strrchr(const char *s, int c) {
 	// The null-terminator is considered to be part of the string.
-	size_t length = strlen(s);
-	for(size_t i = 0; i <= length; i++) {
-		if(s[length - i] == c)
-			return const_cast<char *>(s + (length - i));
-	}
-	return nullptr;
+	auto p = mlibc::byte_scan::find_last_in_string(reinterpret_cast<uintptr_t>(s), c);
+	return reinterpret_cast<char *>(p);
 }
 size_t strspn(const char *s, const char *chrs) {
-	size_t n = 0;
-	while(true) {
-		if(!s[n] || !strchr(chrs, s[n]))
-			return n;
-		n++;
-	}
+	return mlibc::byte_set::span(s, chrs, true);
 }
 char *strstr(const char *s, const char *pattern) {
-	for(size_t i = 0; s[i]; i++) {
-		bool found = true;
-		for(size_t j = 0; pattern[j]; j++) {
-			if(!pattern[j] || s[i + j] == pattern[j])
-				continue;
-			
-			found = false;
-			break;
-		}
-
-		if(found)
-			return const_cast<char *>(&s[i]);
-	}
-
-	return nullptr;
+	return const_cast<char *>(mlibc::find_in_string(s, pattern, false));
 }
 char *strtok(char *__restrict s, const char *__restrict delimiter) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
+	// We use saved = null to memorize that the entire string was consumed.
+	static char *saved;
+	auto tok = s ? s : saved;
+	if(!tok)
+		return nullptr;
+
+	tok += mlibc::byte_set::span(tok, delimiter, true);
+	if(!*tok) {
+		saved = nullptr;
+		return nullptr;
+	}
+
+	auto p = tok + mlibc::byte_set::span(tok, delimiter, false);
+	if(*p) {
+		*p = 0;
+		saved = p + 1;
+	}else{
+		saved = nullptr;
+	}
+	return tok;
 }
 
 // This is a GNU extension.
 char *strchrnul(const char *s, int c) {
-	size_t i = 0;
-	while(s[i]) {
-		if(s[i] == c)
-			return const_cast<char *>(s + i);
-		i++;
-	}
-	return const_cast<char *>(s + i);
+	auto start = reinterpret_cast<uintptr_t>(s);
+	return reinterpret_cast<char *>(mlibc::byte_scan::find_first(start, UINTPTR_MAX, c, true));
+}
+
+// This is a GNU extension.
+void *rawmemchr(const void *s, int c) {
+	auto start = reinterpret_cast<uintptr_t>(s);
+	return reinterpret_cast<void *>(mlibc::byte_scan::find_first(start, UINTPTR_MAX, c, false));
+}
+
+// This is a GNU extension.
+void *memrchr(const void *s, int c, size_t size) {
+	auto p = mlibc::byte_scan::find_last(reinterpret_cast<uintptr_t>(s), size, c);
+	return reinterpret_cast<void *>(p);
+}
+
+// This is a GNU extension.
+void *memmem(const void *haystack, size_t haystack_size,
+		const void *needle, size_t needle_size) {
+	return const_cast<void *>(mlibc::find_in_memory(haystack, haystack_size,
+			needle, needle_size));
+}
+
+// This is a GNU extension.
+char *strcasestr(const char *s, const char *pattern) {
+	return const_cast<char *>(mlibc::find_in_string(s, pattern, true));
 }
 
 double wcstod(const wchar_t *__restrict, wchar_t **__restrict) MLIBC_STUB_BODY
@@ -200,36 +152,72 @@ unsigned long long wcstoull(const wchar_t *__restrict, wchar_t **__restrict, int
 
 wchar_t *wcscpy(wchar_t *__restrict, const wchar_t *__restrict) MLIBC_STUB_BODY
 wchar_t *wcsncpy(wchar_t *__restrict, const wchar_t *__restrict, size_t) MLIBC_STUB_BODY
-wchar_t *wmemcpy(wchar_t *__restrict, const wchar_t *__restrict, size_t) MLIBC_STUB_BODY
-wchar_t *wmemmove(wchar_t *, const wchar_t *, size_t) MLIBC_STUB_BODY
+wchar_t *wmemcpy(wchar_t *__restrict dest, const wchar_t *__restrict src, size_t size) {
+	memcpy(dest, src, size * sizeof(wchar_t));
+	return dest;
+}
+wchar_t *wmemmove(wchar_t *dest, const wchar_t *src, size_t size) {
+	memmove(dest, src, size * sizeof(wchar_t));
+	return dest;
+}
 
 wchar_t *wcscat(wchar_t *__restrict, const wchar_t *__restrict) MLIBC_STUB_BODY
 wchar_t *wcsncat(wchar_t *__restrict, const wchar_t *__restrict, size_t) MLIBC_STUB_BODY
 
-int wcscmp(const wchar_t *, const wchar_t *) MLIBC_STUB_BODY
+int wcscmp(const wchar_t *a, const wchar_t *b) {
+	return mlibc::wide_string::compare_strings(a, b, SIZE_MAX);
+}
 int wcscoll(const wchar_t *, const wchar_t *) MLIBC_STUB_BODY
-int wcsncmp(const wchar_t *, const wchar_t *, size_t) MLIBC_STUB_BODY
+int wcsncmp(const wchar_t *a, const wchar_t *b, size_t max_size) {
+	return mlibc::wide_string::compare_strings(a, b, max_size);
+}
 int wcsxfrm(wchar_t *__restrict, const wchar_t *__restrict, size_t) MLIBC_STUB_BODY
 int wmemcmp(const wchar_t *, const wchar_t *, size_t) MLIBC_STUB_BODY
 
-wchar_t *wcschr(const wchar_t *, wchar_t) MLIBC_STUB_BODY
+wchar_t *wcschr(const wchar_t *s, wchar_t c) {
+	auto p = reinterpret_cast<wchar_t *>(mlibc::wide_string::find_first(
+			reinterpret_cast<uintptr_t>(s), UINTPTR_MAX, c, true));
+	if(*p != c)
+		return nullptr;
+	return p;
+}
 size_t wcscspn(const wchar_t *, const wchar_t *) MLIBC_STUB_BODY
 wchar_t *wcspbrk(const wchar_t *, const wchar_t *) MLIBC_STUB_BODY
-wchar_t *wcsrchr(const wchar_t *, wchar_t) MLIBC_STUB_BODY
+wchar_t *wcsrchr(const wchar_t *s, wchar_t c) {
+	// The null-terminator is considered to be part of the string.
+	auto p = mlibc::wide_string::find_last_in_string(reinterpret_cast<uintptr_t>(s), c);
+	return reinterpret_cast<wchar_t *>(p);
+}
 size_t wcsspn(const wchar_t *, const wchar_t *) MLIBC_STUB_BODY
 wchar_t *wcsstr(const wchar_t *, const wchar_t *) MLIBC_STUB_BODY
 wchar_t *wcstok(wchar_t *__restrict, const wchar_t *__restrict, wchar_t **__restrict) MLIBC_STUB_BODY
 
 wchar_t *wmemchr(const wchar_t *s, wchar_t c, size_t size) {
-	auto s_bytes = s;
-	for(size_t i = 0; i < size; i++)
-		if(s_bytes[i] == c)
-			return const_cast<wchar_t *>(s_bytes + i);
-	return nullptr;
+	auto p = mlibc::wide_string::find_first(reinterpret_cast<uintptr_t>(s),
+			mlibc::wide_string::limit_of(s, size), c, false);
+	return reinterpret_cast<wchar_t *>(p);
 }
 
-size_t wcslen(const wchar_t *) MLIBC_STUB_BODY
-wchar_t *wmemset(wchar_t *, wchar_t, size_t) MLIBC_STUB_BODY
+size_t wcslen(const wchar_t *s) {
+	auto start = reinterpret_cast<uintptr_t>(s);
+	auto p = mlibc::wide_string::find_first(start, UINTPTR_MAX, 0, false);
+	return (p - start) / sizeof(wchar_t);
+}
+
+wchar_t *wmemset(wchar_t *dest, wchar_t c, size_t size) {
+	mlibc::wide_string::fill(dest, c, size);
+	return dest;
+}
+
+// This is a POSIX extension.
+size_t wcsnlen(const wchar_t *s, size_t max_size) {
+	auto start = reinterpret_cast<uintptr_t>(s);
+	auto p = mlibc::wide_string::find_first(start,
+			mlibc::wide_string::limit_of(s, max_size), 0, false);
+	if(!p)
+		return max_size;
+	return (p - start) / sizeof(wchar_t);
+}
 
 char *strerror(int e) {
 	const char *s;
@@ -274,8 +262,34 @@ void *mempcpy(void *dest, const void *src, size_t len) {
 }
 
 char *stpcpy(char *__restrict dest, const char *__restrict src) {
-	auto n = strlen(src);
-	memcpy(dest, src, n + 1);
+	auto n = mlibc::byte_copy::copy_string(dest, src, SIZE_MAX);
+	dest[n] = 0;
+	return dest + n;
+}
+
+char *stpncpy(char *__restrict dest, const char *__restrict src, size_t max_size) {
+	auto n = mlibc::byte_copy::copy_string(dest, src, max_size);
+	memset(dest + n, 0, max_size - n);
 	return dest + n;
 }
 
+// BSD extensions.
+
+size_t strlcpy(char *__restrict dest, const char *__restrict src, size_t size) {
+	if(!size)
+		return strlen(src);
+	auto n = mlibc::byte_copy::copy_string(dest, src, size - 1);
+	dest[n] = 0;
+	// Return the length of the string that we tried to create.
+	return n + strlen(src + n);
+}
+
+size_t strlcat(char *__restrict dest, const char *__restrict src, size_t size) {
+	auto end = mlibc::byte_scan::find_first(reinterpret_cast<uintptr_t>(dest),
+			mlibc::byte_scan::limit_of(dest, size), 0, false);
+	if(!end)
+		return size + strlen(src);
+	auto length = end - reinterpret_cast<uintptr_t>(dest);
+	return length + strlcpy(dest + length, src, size - length);
+}
+
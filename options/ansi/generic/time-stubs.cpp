@@ -12,6 +12,7 @@
 #include <bits/ensure.h>
 #include <mlibc/debug.hpp>
 #include <mlibc/file-window.hpp>
+#include <mlibc/int-format.hpp>
 #include <mlibc/sysdeps.hpp>
 
 clock_t clock(void) {
@@ -54,6 +55,17 @@ size_t strftime(char *__restrict dest, size_t max_size,
 		const char *__restrict format, const struct tm *__restrict tm) {
 	auto c = format;
 	auto p = dest;
+
+	// Writes a number but leaves space for the null terminator.
+	auto emit_number = [&] (int value, int min_digits) -> bool {
+		char buffer[mlibc::max_integer_digits + 1];
+		auto n = mlibc::format_signed_decimal(buffer, value, min_digits);
+		if(n >= (dest + max_size) - p)
+			return false;
+		memcpy(p, buffer, n);
+		p += n;
+		return true;
+	};
 	
 	while(*c) {
 		auto space = (dest + max_size) - p;
@@ -69,22 +81,16 @@ size_t strftime(char *__restrict dest, size_t max_size,
 		}
 		
 		if(*(c + 1) == 'Y') {
-			auto chunk = snprintf(p, space, "%d", 1900 + tm->tm_year);
-			if(chunk >= space)
+			if(!emit_number(1900 + tm->tm_year, 1))
 				return 0;
-			p += chunk;
 			c += 2;
 		}else if (*(c + 1) == 'm') {
-			auto chunk = snprintf(p, space, "%.2d", tm->tm_mon + 1);
-			if(chunk >= space)
+			if(!emit_number(tm->tm_mon + 1, 2))
 				return 0;
-			p += chunk;
 			c += 2;
 		}else if (*(c + 1) == 'd') {
-			auto chunk = snprintf(p, space, "%.2d", tm->tm_mday);
-			if(chunk >= space)
+			if(!emit_number(tm->tm_mday, 2))
 				return 0;
-			p += chunk;
 			c += 2;
 		}else if (*(c + 1) == 'Z') {
 			auto chunk = snprintf(p, space, "%s", "GMT");
@@ -93,22 +99,16 @@ size_t strftime(char *__restrict dest, size_t max_size,
 			p += chunk;
 			c += 2;
 		}else if (*(c + 1) == 'H') {
-			auto chunk = snprintf(p, space, "%.2i", tm->tm_hour);
-			if(chunk >= space)
+			if(!emit_number(tm->tm_hour, 2))
 				return 0;
-			p += chunk;
 			c += 2;
 		}else if (*(c + 1) == 'M') {
-			auto chunk = snprintf(p, space, "%.2i", tm->tm_min);
-			if(chunk >= space)
+			if(!emit_number(tm->tm_min, 2))
 				return 0;
-			p += chunk;
 			c += 2;
 		}else if (*(c + 1) == 'S') {
-			auto chunk = snprintf(p, space, "%.2d", tm->tm_sec);
-			if(chunk >= space)
+			if(!emit_number(tm->tm_sec, 2))
 				return 0;
-			p += chunk;
 			c += 2;
 		}else if (*(c + 1) == 'F') {
 			auto chunk = snprintf(p, space, "%d/%.2d/%.2d", 1900 + tm->tm_year, tm->tm_mon + 1,
@@ -148,19 +148,15 @@ size_t strftime(char *__restrict dest, size_t max_size,
 			p += chunk;
 			c += 2;
 		}else if (*(c + 1) == 'd') {
-			auto chunk = snprintf(p, space, "%.2d", tm->tm_mday);
-			if(chunk >= space)
+			if(!emit_number(tm->tm_mday, 2))
 				return 0;
-			p += chunk;
 			c += 2;
 		}else if (*(c + 1) == 'I') {
 			int hour = tm->tm_hour;
 			if(hour > 12)
 				hour -= 12;
-			auto chunk = snprintf(p, space, "%.2i", hour);
-			if(chunk >= space)
+			if(!emit_number(hour, 2))
 				return 0;
-			p += chunk;
 			c += 2;
 		}else if (*(c + 1) == 'p') {
 			if(tm->tm_hour < 12) {
@@ -1,7 +1,9 @@
 #ifndef MLIBC_FILE_IO_HPP
 #define MLIBC_FILE_IO_HPP
 
+#include <stdint.h>
 #include <stdio.h>
+#include <stdio_ext.h>
 
 #include <frg/list.hpp>
 
@@ -20,6 +22,16 @@ enum class buffer_mode {
 	full_buffer
 };
 
+// Allocator for FILE objects and their buffers. It keeps a few freed blocks
+// of each size class around, such that programs that repeatedly open and close
+// files do not allocate anything in steady state.
+struct file_allocator {
+	void *allocate(size_t size);
+	void free(void *pointer);
+};
+
+file_allocator &getFileAllocator();
+
 struct abstract_file : __mlibc_file_base {
 public:
 	abstract_file(void (*do_dispose)(abstract_file *) = nullptr);
@@ -34,9 +46,12 @@ public:
 
 	virtual int close() = 0;
 
+	// Returns the underlying file descriptor or -1 if the stream is not backed by one.
+	virtual int fd();
+
 	int read(char *buffer, size_t max_size, size_t *actual_size);
 	int write(const char *buffer, size_t max_size, size_t *actual_size);
-	void unget(char c);
+	int unget(char c);
 
 	int update_bufmode(buffer_mode mode);
 
@@ -46,6 +61,15 @@ public:
 	int tell(off_t *current_offset);
 	int seek(off_t offset, int whence);
 
+	// Orients the stream (see fwide()) unless it is already oriented.
+	// Returns the orientation: negative for byte streams, positive for wide streams
+	// and zero if the stream has no orientation yet.
+	int orient(int mode);
+
+	const __mlibc_fstats &stats() {
+		return _stats;
+	}
+
 protected:
 	virtual int determine_type(stream_type *type) = 0;
 	virtual int determine_bufmode(buffer_mode *mode) = 0;
@@ -53,6 +77,30 @@ protected:
 	virtual int io_write(const char *buffer, size_t max_size, size_t *actual_size) = 0;
 	virtual int io_seek(off_t offset, int whence, off_t *new_offset) = 0;
 
+	// Fills the (empty) buffer with data from the current I/O position.
+	// By default, this reads into a heap-allocated buffer; files that can expose
+	// their contents directly (e.g. mmap_file) replace the buffer instead.
+	virtual int io_fill_buffer(size_t *actual_size);
+
+	// Passes an access pattern hint (POSIX_FADV_*) to the underlying file.
+	// Hints are optional; the default implementation ignores them.
+	virtual int io_advise(int advice);
+
+	// Waits until all data that was passed to io_write() has reached the file.
+	// Only files that complete writes asynchronously need to implement this.
+	virtual int io_drain();
+
+	// Called before unget() or write() modify the buffer. Files whose buffer is backed
+	// by something other than the heap (e.g. mmap_file) need to replace it by a copy.
+	virtual int io_unshare_buffer();
+
+	// Whether writes always go to the end of the file (i.e., O_APPEND).
+	// After writing to such a file, the I/O position has to be queried again.
+	virtual bool writes_append();
+
+	// Changes the size of the (not yet allocated) buffer.
+	void _set_buffer_size(size_t size);
+
 private:
 	int _init_type();
 	int _init_bufmode();
@@ -62,22 +110,56 @@ private:
 	int _reset();
 	void _ensure_allocation();
 
+	void _note_refill();
+	void _note_random_seek();
+
+	// Wrappers around io_write() and io_seek() that update the statistics.
+	int _counted_io_write(const char *buffer, size_t max_size, size_t *actual_size);
+	int _counted_io_seek(off_t offset, int whence, off_t *new_offset);
+
 	stream_type _type;
 	buffer_mode _bufmode;
 	void (*_do_dispose)(abstract_file *);
 
+	// Cached position of the underlying file (i.e., the position that corresponds
+	// to __io_offset). Only valid if _io_position_known is true.
+	off_t _io_position;
+	bool _io_position_known;
+
+	// Whether unget() pushed back characters that differ from the buffered data.
+	// Until the buffer is discarded, it does not reflect the file contents.
+	bool _pushed_back;
+
+	// Access pattern detection: after a number of consecutive refills we assume
+	// sequential access and grow the buffer, after a number of seeks we shrink it.
+	int _sequential_refills;
+	int _random_seeks;
+	int _advice;
+	size_t _preferred_buffer_size;
+
+	// Orientation of the stream, as returned by orient().
+	int _orientation;
+
+	// I/O statistics that can be queried via __fstats().
+	__mlibc_fstats _stats;
+
 public:
 	// All files are stored in a global linked list, so that they can be flushed at exit().
 	frg::default_list_hook<abstract_file> _list_hook;
 };
 
 struct fd_file : abstract_file {
-	fd_file(int fd, void (*do_dispose)(abstract_file *) = nullptr);
+	fd_file(int fd, void (*do_dispose)(abstract_file *) = nullptr, bool append = false);
 
-	int fd();
+	int fd() override;
 
 	int close() override;
 
+	// Enables write-behind: io_write() copies the data to a second buffer and submits
+	// it asynchronously; errors are reported by the next operation on the file.
+	// Must be called before performing I/O.
+	int enable_write_behind();
+
 protected:
 	int determine_type(stream_type *type) override;
 	int determine_bufmode(buffer_mode *mode) override;
@@ -85,10 +167,140 @@ protected:
 	int io_read(char *buffer, size_t max_size, size_t *actual_size) override;
 	int io_write(const char *buffer, size_t max_size, size_t *actual_size) override;
 	int io_seek(off_t offset, int whence, off_t *new_offset) override;
+	int io_advise(int advice) override;
+	int io_drain() override;
+	bool writes_append() override;
 
 private:
 	// Underlying file descriptor.
 	int _fd;
+	bool _append;
+
+	// State of the write-behind mode. While a write is in flight,
+	// _write_buffer must not be touched.
+	bool _write_behind;
+	bool _write_pending;
+	uint64_t _write_ticket;
+	char *_write_buffer;
+	size_t _write_capacity;
+	size_t _write_size;
+
+	// Tracks the file position in write-behind mode; this avoids waiting for
+	// the pending write when abstract_file only queries the current position.
+	off_t _position;
+	bool _position_known;
+};
+
+// Read-only regular file that serves reads directly from a memory mapping
+// instead of copying the data through sys_read() (see fopen() mode "m").
+// Files that cannot be mapped fall back to the behavior of fd_file.
+struct mmap_file : fd_file {
+	mmap_file(int fd, void (*do_dispose)(abstract_file *) = nullptr);
+
+	~mmap_file();
+
+protected:
+	int determine_bufmode(buffer_mode *mode) override;
+
+	int io_read(char *buffer, size_t max_size, size_t *actual_size) override;
+	int io_seek(off_t offset, int whence, off_t *new_offset) override;
+	int io_fill_buffer(size_t *actual_size) override;
+	int io_unshare_buffer() override;
+
+private:
+	int _init_mapping();
+	int _map_window();
+
+	bool _initialized;
+	bool _fallback;
+	off_t _file_size;
+
+	// We track the file position ourselves; the position of the FD is never changed.
+	off_t _position;
+
+	char *_window;
+	size_t _window_size;
+	off_t _window_offset;
+
+	// Whether __buffer_ptr points into the (read-only) window.
+	bool _buffer_in_window;
+};
+
+// Stream that operates on a fixed-size memory region (see fmemopen()).
+// I/O is performed directly on the memory region, i.e., the stream is never buffered.
+struct mem_file : abstract_file {
+	mem_file(char *memory, size_t size, int flags, bool owns_memory,
+			void (*do_dispose)(abstract_file *) = nullptr);
+
+	int close() override;
+
+protected:
+	int determine_type(stream_type *type) override;
+	int determine_bufmode(buffer_mode *mode) override;
+
+	int io_read(char *buffer, size_t max_size, size_t *actual_size) override;
+	int io_write(const char *buffer, size_t max_size, size_t *actual_size) override;
+	int io_seek(off_t offset, int whence, off_t *new_offset) override;
+
+private:
+	char *_memory;
+	// Capacity of the memory region.
+	size_t _size;
+	// Current length of the contents (i.e., the position of SEEK_END).
+	size_t _length;
+	// Current position within the memory region.
+	size_t _position;
+	// Access mode and O_APPEND.
+	int _flags;
+	bool _owns_memory;
+};
+
+// Stream that writes to a dynamically growing buffer (see open_memstream()).
+// Similar to mem_file, I/O is performed directly on the buffer.
+struct memstream_file : abstract_file {
+	memstream_file(char **ptr, size_t *sizeloc, char *initial, size_t capacity,
+			void (*do_dispose)(abstract_file *) = nullptr);
+
+	int close() override;
+
+protected:
+	int determine_type(stream_type *type) override;
+	int determine_bufmode(buffer_mode *mode) override;
+
+	int io_read(char *buffer, size_t max_size, size_t *actual_size) override;
+	int io_write(const char *buffer, size_t max_size, size_t *actual_size) override;
+	int io_seek(off_t offset, int whence, off_t *new_offset) override;
+
+private:
+	// Publishes the buffer and the current position to the user.
+	void _publish();
+
+	char **_ptr;
+	size_t *_sizeloc;
+	char *_memory;
+	size_t _capacity;
+	size_t _length;
+	size_t _position;
+};
+
+// Stream that forwards all I/O to user-supplied callbacks (see fopencookie()).
+struct cookie_file : abstract_file {
+	cookie_file(void *cookie, cookie_io_functions_t io_funcs,
+			void (*do_dispose)(abstract_file *) = nullptr);
+
+	int close() override;
+
+protected:
+	int determine_type(stream_type *type) override;
+	int determine_bufmode(buffer_mode *mode) override;
+
+	int io_read(char *buffer, size_t max_size, size_t *actual_size) override;
+	int io_write(const char *buffer, size_t max_size, size_t *actual_size) override;
+	int io_seek(off_t offset, int whence, off_t *new_offset) override;
+
+private:
+	void *_cookie;
+	cookie_io_functions_t _io_funcs;
 };
 
 } // namespace mlibc
@@ -88,6 +88,10 @@ void *bsearch(const void *key, const void *base, size_t count, size_t size,
 void qsort(void *base, size_t count, size_t size,
 		int (*compare)(const void *, const void *));
 
+// GLIBC extension.
+void qsort_r(void *base, size_t count, size_t size,
+		int (*compare)(const void *, const void *, void *), void *arg);
+
 // [7.22.6] Integer arithmetic functions
 
 int abs(int number);
@@ -40,8 +40,12 @@ size_t strspn(const char *s, const char *chrs);
 char *strstr(const char *pattern, const char *s);
 char *strtok(char *__restrict s, const char *__restrict delimiter);
 
-// This is a GNU extension.
+// These are GNU extensions.
 char *strchrnul(const char *, int);
+void *rawmemchr(const void *, int);
+void *memrchr(const void *, int, size_t);
+void *memmem(const void *, size_t, const void *, size_t);
+char *strcasestr(const char *, const char *);
 
 // [7.24.6] Miscellaneous functions
 
@@ -54,6 +58,11 @@ size_t strlen(const char *s);
 int strerror_r(int, char *, size_t);
 void *mempcpy(void *, const void *, size_t);
 char *stpcpy(char *__restrict, const char *__restrict);
+char *stpncpy(char *__restrict, const char *__restrict, size_t);
+
+// These are BSD extensions.
+size_t strlcpy(char *__restrict, const char *__restrict, size_t);
+size_t strlcat(char *__restrict, const char *__restrict, size_t);
 
 #ifdef __cplusplus
 }
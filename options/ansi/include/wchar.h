@@ -113,6 +113,7 @@ size_t wcsrtombs(char *__restrict, const wchar_t **__restrict, size_t, mbstate_t
 
 // POSIX extensions
 int wcwidth(wchar_t wc);
+size_t wcsnlen(const wchar_t *, size_t);
 
 #ifdef __cplusplus
 }
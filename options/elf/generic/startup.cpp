@@ -1,14 +1,57 @@
 
+#include <ctype.h>
 #include <errno.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <elf.h>
 #include <bits/ensure.h>
+#include <mlibc/cpu-features.hpp>
 #include <mlibc/elf/startup.h>
 
 extern "C" size_t __init_array_start[];
 extern "C" size_t __init_array_end[];
 
+// In static executables, there is no dynamic linker that processes IRELATIVE relocations.
+// The linker collects them in .rela.iplt (.rel.iplt on i386) and marks its boundaries.
+#if defined(__x86_64__)
+
+extern "C" __attribute__((weak, visibility("hidden"))) Elf64_Rela __rela_iplt_start[];
+extern "C" __attribute__((weak, visibility("hidden"))) Elf64_Rela __rela_iplt_end[];
+
+static void apply_irelative_relocations() {
+	for(auto reloc = __rela_iplt_start; reloc != __rela_iplt_end; reloc++) {
+		__ensure(ELF64_R_TYPE(reloc->r_info) == R_X86_64_IRELATIVE);
+		auto resolver = reinterpret_cast<uintptr_t (*)()>(reloc->r_addend);
+		*reinterpret_cast<uintptr_t *>(reloc->r_offset) = resolver();
+	}
+}
+
+#elif defined(__i386__)
+
+struct iplt_rel {
+	uint32_t r_offset;
+	uint32_t r_info;
+};
+
+extern "C" __attribute__((weak, visibility("hidden"))) iplt_rel __rel_iplt_start[];
+extern "C" __attribute__((weak, visibility("hidden"))) iplt_rel __rel_iplt_end[];
+
+static void apply_irelative_relocations() {
+	for(auto reloc = __rel_iplt_start; reloc != __rel_iplt_end; reloc++) {
+		__ensure((reloc->r_info & 0xFF) == R_386_IRELATIVE);
+		// The address of the resolver is stored as an implicit addend.
+		auto target = reinterpret_cast<uintptr_t *>(reloc->r_offset);
+		*target = reinterpret_cast<uintptr_t (*)()>(*target)();
+	}
+}
+
+#else
+
+static void apply_irelative_relocations() { }
+
+#endif
+
 static int constructors_ran_already = 0;
 
 struct global_constructor_guard {
@@ -19,8 +62,27 @@ struct global_constructor_guard {
 
 static global_constructor_guard g;
 
+// Allows programs to tune the size above which memcpy() and memset() bypass the cache.
+// Invalid values (and zero, which would make every copy bypass the cache) are ignored.
+static void read_non_temporal_threshold() {
+    const char *threshold = getenv("MLIBC_NT_THRESHOLD");
+    if (!threshold || !isdigit(threshold[0]))
+        return;
+    char *end;
+    unsigned long long value = strtoull(threshold, &end, 0);
+    if (*end || !value)
+        return;
+    mlibc::setNonTemporalThreshold(value > SIZE_MAX ? SIZE_MAX : value);
+}
+
 void __mlibc_run_constructors() {
     if (!constructors_ran_already) {
+        // IFUNCs must be resolved before any code (including constructors) calls them.
+        // This must only happen once: resolving again would rewrite slots that are in use
+        // (and on i386, the slots no longer contain the resolvers).
+        apply_irelative_relocations();
+        read_non_temporal_threshold();
+
         size_t constructor_count = (size_t)__init_array_end - (size_t)__init_array_start;
         constructor_count /= sizeof(void*);
         for (size_t i = 0; i < constructor_count; i++) {
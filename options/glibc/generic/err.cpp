@@ -3,26 +3,64 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// Formats the complete message first and writes it using a single fwrite().
+// As stderr is unbuffered, this results in a single write() for most messages
+// and prevents messages of different threads from interleaving.
+void print_message(const char *fmt, va_list params, bool with_error) {
+	int error = errno;
+
+	auto format_into = [&] (char *buffer, size_t size, va_list args) -> size_t {
+		size_t n = snprintf(buffer, size, "%s: ", program_invocation_short_name);
+		if (fmt)
+			n += vsnprintf(buffer + (n < size ? n : size), n < size ? size - n : 0, fmt, args);
+		auto rest = buffer + (n < size ? n : size);
+		auto rest_size = n < size ? size - n : 0;
+		if (with_error) {
+			n += snprintf(rest, rest_size, fmt ? ": %s\n" : "%s\n", strerror(error));
+		}else{
+			n += snprintf(rest, rest_size, "\n");
+		}
+		return n;
+	};
+
+	char buffer[512];
+	va_list copy;
+	va_copy(copy, params);
+	auto n = format_into(buffer, sizeof(buffer), copy);
+	va_end(copy);
+	if (n < sizeof(buffer)) {
+		fwrite(buffer, 1, n, stderr);
+		return;
+	}
+
+	// The message does not fit into the stack buffer.
+	auto heap_buffer = static_cast<char *>(malloc(n + 1));
+	if (!heap_buffer) {
+		fwrite(buffer, 1, sizeof(buffer) - 1, stderr);
+		return;
+	}
+	va_copy(copy, params);
+	format_into(heap_buffer, n + 1, copy);
+	va_end(copy);
+	fwrite(heap_buffer, 1, n, stderr);
+	free(heap_buffer);
+}
+
+} // anonymous namespace
 
 // va_list
 
 void vwarn(const char *fmt, va_list params) {
-	fprintf(stderr, "%s: ", program_invocation_short_name);
-	if (fmt) {
-		vfprintf(stderr, fmt, params);
-                fwrite(": ", 1, 2, stderr);
-	}
-	perror(NULL);
+	print_message(fmt, params, true);
 }
 
 void vwarnx(const char *fmt, va_list params) {
-	fprintf(stderr, "%s: ", program_invocation_short_name);
-	if (fmt) {
-		vfprintf(stderr, fmt, params);
-	}
-	putc('\n', stderr);
+	print_message(fmt, params, false);
 }
-
 __attribute__((noreturn)) void verr(int status, const char *fmt, va_list params) {
 	vwarn(fmt, params);
 	exit(status);
@@ -30,6 +30,32 @@ size_t __freadahead(FILE *);
 const char *__freadptr(FILE *, size_t *);
 void __fseterr(FILE *);
 
+// The following functions are mlibc extensions.
+
+struct __mlibc_fstats {
+	// Number of times that the buffer was refilled or written back.
+	unsigned long refills;
+	unsigned long write_backs;
+
+	// Number of operations on the underlying file.
+	unsigned long reads;
+	unsigned long writes;
+	unsigned long seeks;
+
+	// Number of writes that transferred less data than requested.
+	unsigned long partial_writes;
+
+	// Number of bytes transferred from and to the underlying file.
+	unsigned long long bytes_read;
+	unsigned long long bytes_written;
+};
+
+// Retrieves the I/O statistics of a stream.
+int __fstats(FILE *, struct __mlibc_fstats *);
+
+// Prints the I/O statistics of all open streams.
+void __fstats_dump(FILE *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -40,8 +40,8 @@ struct utf8_charcode {
 					return charcode_error::illegal_input;
 				}
 			}else{
-				// TODO: Return an error.
-				__ensure((uc & 0b1100'0000) == 0b1000'0000);
+				if((uc & 0b1100'0000) != 0b1000'0000)
+					return charcode_error::illegal_input;
 				_cpoint = (_cpoint << 6) | (uc & 0x3F);
 				--_progress;
 			}
@@ -59,10 +59,39 @@ struct utf8_charcode {
 		// TODO: Convert decode_state to the same strategy.
 		charcode_error operator() (code_seq<char> &nseq, code_seq<const codepoint> &wseq) {
 			auto wc = *wseq.it;
-			__ensure(wc <= 0x7F && "utf8_charcode cannot encode multibyte chars yet");
-			*nseq.it = wc;
+			if(wc <= 0x7F) {
+				if(nseq.it == nseq.end)
+					return charcode_error::output_overflow;
+				*nseq.it = wc;
+				++wseq.it;
+				++nseq.it;
+				return charcode_error::null;
+			}
+
+			// Surrogates cannot be represented in UTF-8.
+			if(wc > 0x10FFFF || (wc >= 0xD800 && wc <= 0xDFFF))
+				return charcode_error::illegal_input;
+
+			int n = 2;
+			unsigned char lead = 0b1100'0000;
+			if(wc > 0xFFFF) {
+				n = 4;
+				lead = 0b1111'0000;
+			}else if(wc > 0x7FF) {
+				n = 3;
+				lead = 0b1110'0000;
+			}
+			// Only emit complete sequences.
+			if(nseq.end - nseq.it < n)
+				return charcode_error::output_overflow;
+
+			for(int i = n - 1; i > 0; i--) {
+				nseq.it[i] = 0b1000'0000 | (wc & 0x3F);
+				wc >>= 6;
+			}
+			nseq.it[0] = lead | wc;
 			++wseq.it;
-			++nseq.it;
+			nseq.it += n;
 			return charcode_error::null;
 		}
 	};
@@ -0,0 +1,174 @@
+
+#include <stdint.h>
+
+#include <bits/ensure.h>
+#include <mlibc/cpu-features.hpp>
+
+namespace mlibc {
+
+namespace {
+
+// Written only by the thread that moves detectionState from notDetected to detecting.
+cpu_features detectedFeatures;
+
+enum : int { notDetected, detecting, detected };
+int detectionState;
+
+// Zero until either the default or an explicit threshold is set.
+size_t nonTemporalThreshold;
+
+#if defined(__x86_64__) || defined(__i386__)
+
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t *regs) {
+	asm volatile ("cpuid"
+			: "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+			: "a"(leaf), "c"(subleaf));
+}
+
+void detectFeatures(cpu_features &features) {
+	uint32_t regs[4];
+	cpuid(0, 0, regs);
+	uint32_t max_leaf = regs[0];
+	if(max_leaf < 1)
+		return;
+
+	cpuid(1, 0, regs);
+	features.sse42 = regs[2] & (1 << 20);
+
+	// The OS announces that it saves the extended register state via OSXSAVE;
+	// XCR0 tells us which parts of the state are actually saved.
+	uint32_t xcr0 = 0;
+	if(regs[2] & (1 << 27)) {
+		uint32_t xcr0_high;
+		asm volatile ("xgetbv" : "=a"(xcr0), "=d"(xcr0_high) : "c"(0));
+	}
+	bool os_ymm = (xcr0 & 0x6) == 0x6; // SSE and AVX state.
+	bool os_zmm = os_ymm && (xcr0 & 0xE0) == 0xE0; // Opmask and ZMM state.
+	features.avx = os_ymm && (regs[2] & (1 << 28));
+
+	if(max_leaf < 7)
+		return;
+
+	cpuid(7, 0, regs);
+	features.avx2 = features.avx && (regs[1] & (1 << 5));
+	features.bmi2 = regs[1] & (1 << 8);
+	features.erms = regs[1] & (1 << 9);
+	features.fsrm = regs[3] & (1 << 4);
+	features.avx512f = os_zmm && (regs[1] & (1 << 16));
+	features.avx512bw = features.avx512f && (regs[1] & (1 << 30));
+	features.avx512vl = features.avx512f && (regs[1] & (1u << 31));
+}
+
+// Computes the size of a cache from the parameters that leaves 4 and 0x8000001D report.
+size_t cacheSizeOf(const uint32_t *regs) {
+	size_t ways = (regs[1] >> 22) + 1;
+	size_t partitions = ((regs[1] >> 12) & 0x3FF) + 1;
+	size_t line_size = (regs[1] & 0xFFF) + 1;
+	size_t sets = size_t(regs[2]) + 1;
+	return ways * partitions * line_size * sets;
+}
+
+// Enumerates the caches that a leaf reports and returns the size of the data
+// (or unified) cache with the highest level.
+size_t enumerateCaches(uint32_t leaf) {
+	uint32_t regs[4];
+	size_t size = 0;
+	unsigned int level = 0;
+	for(uint32_t i = 0; i < 16; i++) {
+		cpuid(leaf, i, regs);
+		uint32_t type = regs[0] & 0x1F;
+		if(!type)
+			break;
+		if(type == 2) // Instruction cache.
+			continue;
+		unsigned int this_level = (regs[0] >> 5) & 0x7;
+		if(this_level >= level) {
+			level = this_level;
+			size = cacheSizeOf(regs);
+		}
+	}
+	return size;
+}
+
+size_t detectCacheSize() {
+	uint32_t regs[4];
+	cpuid(0, 0, regs);
+	uint32_t max_leaf = regs[0];
+	cpuid(0x80000000, 0, regs);
+	uint32_t max_ext_leaf = regs[0];
+
+	// Intel enumerates caches in leaf 4; AMD uses leaf 0x8000001D with the same layout
+	// (if topology extensions are supported).
+	if(max_leaf >= 4) {
+		if(size_t size = enumerateCaches(4); size)
+			return size;
+	}
+	if(max_ext_leaf >= 0x80000001) {
+		cpuid(0x80000001, 0, regs);
+		if(max_ext_leaf >= 0x8000001D && (regs[2] & (1 << 22))) {
+			if(size_t size = enumerateCaches(0x8000001D); size)
+				return size;
+		}
+	}
+
+	// Fall back to the legacy AMD leaf that reports the L2 and L3 sizes.
+	if(max_ext_leaf >= 0x80000006) {
+		cpuid(0x80000006, 0, regs);
+		if(size_t l3 = size_t(regs[3] >> 18) * 512 * 1024; l3)
+			return l3;
+		return size_t(regs[2] >> 16) * 1024;
+	}
+	return 0;
+}
+
+#else
+
+void detectFeatures(cpu_features &) { }
+
+size_t detectCacheSize() {
+	return 0;
+}
+
+#endif
+
+} // anonymous namespace
+
+const cpu_features &getCpuFeatures() {
+	if(__builtin_expect(__atomic_load_n(&detectionState, __ATOMIC_ACQUIRE) == detected, 1))
+		return detectedFeatures;
+
+	int expected = notDetected;
+	if(__atomic_compare_exchange_n(&detectionState, &expected, detecting, false,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		detectFeatures(detectedFeatures);
+		detectedFeatures.cache_size = detectCacheSize();
+		__atomic_store_n(&detectionState, detected, __ATOMIC_RELEASE);
+	}else{
+		// Another thread is detecting the features; this only takes a few cpuid instructions.
+		while(__atomic_load_n(&detectionState, __ATOMIC_ACQUIRE) != detected)
+			;
+	}
+	return detectedFeatures;
+}
+
+size_t getNonTemporalThreshold() {
+	if(size_t threshold = __atomic_load_n(&nonTemporalThreshold, __ATOMIC_RELAXED);
+			__builtin_expect(threshold != 0, 1))
+		return threshold;
+
+	// Do not overwrite a threshold that setNonTemporalThreshold() stored in the meantime.
+	size_t cache_size = getCpuFeatures().cache_size;
+	size_t expected = 0;
+	size_t threshold = cache_size ? cache_size / 4 * 3 : SIZE_MAX;
+	if(!__atomic_compare_exchange_n(&nonTemporalThreshold, &expected, threshold, false,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return expected;
+	return threshold;
+}
+
+void setNonTemporalThreshold(size_t threshold) {
+	__ensure(threshold);
+	__atomic_store_n(&nonTemporalThreshold, threshold, __ATOMIC_RELAXED);
+}
+
+} // namespace mlibc
@@ -1,38 +1,445 @@
 
+#include <stdint.h>
 #include <string.h>
 
+#include <mlibc/byte-scan.hpp>
+#include <mlibc/cpu-features.hpp>
+
+// GCC recognizes copy loops and turns them into calls to memcpy() and memset(),
+// which would make these functions call themselves.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("no-tree-loop-distribute-patterns")
+#endif
+
+namespace {
+
+// Types for unaligned accesses that may alias anything.
+typedef uint16_t __attribute__((__aligned__(1), __may_alias__)) unaligned_u16;
+typedef uint32_t __attribute__((__aligned__(1), __may_alias__)) unaligned_u32;
+typedef uint64_t __attribute__((__aligned__(1), __may_alias__)) unaligned_u64;
+typedef size_t __attribute__((__may_alias__)) word;
+
+// Copies 0 to 16 bytes. All loads happen before the first store, hence,
+// the buffers may overlap. Sizes that are not a power of two are handled by two
+// overlapping accesses instead of a loop.
+inline void copy_small(char *dest, const char *src, size_t size) {
+	if(size >= 8) {
+		uint64_t head = *reinterpret_cast<const unaligned_u64 *>(src);
+		uint64_t tail = *reinterpret_cast<const unaligned_u64 *>(src + size - 8);
+		*reinterpret_cast<unaligned_u64 *>(dest) = head;
+		*reinterpret_cast<unaligned_u64 *>(dest + size - 8) = tail;
+	}else if(size >= 4) {
+		uint32_t head = *reinterpret_cast<const unaligned_u32 *>(src);
+		uint32_t tail = *reinterpret_cast<const unaligned_u32 *>(src + size - 4);
+		*reinterpret_cast<unaligned_u32 *>(dest) = head;
+		*reinterpret_cast<unaligned_u32 *>(dest + size - 4) = tail;
+	}else if(size >= 2) {
+		uint16_t head = *reinterpret_cast<const unaligned_u16 *>(src);
+		uint16_t tail = *reinterpret_cast<const unaligned_u16 *>(src + size - 2);
+		*reinterpret_cast<unaligned_u16 *>(dest) = head;
+		*reinterpret_cast<unaligned_u16 *>(dest + size - 2) = tail;
+	}else if(size) {
+		*dest = *src;
+	}
+}
+
+// Sets 0 to 16 bytes to the byte in the low bits of pattern
+// (which needs to be repeated in all bytes of pattern).
+inline void set_small(char *dest, uint64_t pattern, size_t size) {
+	if(size >= 8) {
+		*reinterpret_cast<unaligned_u64 *>(dest) = pattern;
+		*reinterpret_cast<unaligned_u64 *>(dest + size - 8) = pattern;
+	}else if(size >= 4) {
+		*reinterpret_cast<unaligned_u32 *>(dest) = pattern;
+		*reinterpret_cast<unaligned_u32 *>(dest + size - 4) = pattern;
+	}else if(size >= 2) {
+		*reinterpret_cast<unaligned_u16 *>(dest) = pattern;
+		*reinterpret_cast<unaligned_u16 *>(dest + size - 2) = pattern;
+	}else if(size) {
+		*dest = pattern;
+	}
+}
+
+#if defined(__x86_64__)
+
+// SSE2 is part of the x86_64 baseline; AVX2 and ERMS are detected at runtime.
+typedef char v16 __attribute__((__vector_size__(16), __aligned__(1), __may_alias__));
+typedef char v32 __attribute__((__vector_size__(32), __aligned__(1), __may_alias__));
+typedef uint64_t v16_u64 __attribute__((__vector_size__(16)));
+typedef long long v16_i64 __attribute__((__vector_size__(16)));
+
+// Sizes above this threshold are handled by rep movsb/stosb if the CPU supports ERMS.
+// Below, the startup overhead of the string instructions dominates.
+constexpr size_t rep_threshold = 2048;
+
+inline v16 load16(const char *p) {
+	return *reinterpret_cast<const v16 *>(p);
+}
+
+inline void store16(char *p, v16 v) {
+	*reinterpret_cast<v16 *>(p) = v;
+}
+
+// Store that bypasses the cache (movntdq). p must be 16-byte aligned.
+inline void stream16(char *p, v16 v) {
+	__builtin_ia32_movntdq(reinterpret_cast<v16_i64 *>(p), (v16_i64)v);
+}
+
+// Copies 17 to 128 bytes using overlapping 16-byte accesses.
+// All loads happen before the first store, hence, the buffers may overlap.
+inline void copy_medium(char *dest, const char *src, size_t size) {
+	if(size <= 32) {
+		v16 a = load16(src);
+		v16 b = load16(src + size - 16);
+		store16(dest, a);
+		store16(dest + size - 16, b);
+	}else if(size <= 64) {
+		v16 a = load16(src);
+		v16 b = load16(src + 16);
+		v16 c = load16(src + size - 32);
+		v16 d = load16(src + size - 16);
+		store16(dest, a);
+		store16(dest + 16, b);
+		store16(dest + size - 32, c);
+		store16(dest + size - 16, d);
+	}else{
+		v16 a = load16(src);
+		v16 b = load16(src + 16);
+		v16 c = load16(src + 32);
+		v16 d = load16(src + 48);
+		v16 e = load16(src + size - 64);
+		v16 f = load16(src + size - 48);
+		v16 g = load16(src + size - 32);
+		v16 h = load16(src + size - 16);
+		store16(dest, a);
+		store16(dest + 16, b);
+		store16(dest + 32, c);
+		store16(dest + 48, d);
+		store16(dest + size - 64, e);
+		store16(dest + size - 48, f);
+		store16(dest + size - 32, g);
+		store16(dest + size - 16, h);
+	}
+}
+
+// Copies more than 128 bytes from front to back in chunks of 64 bytes;
+// the stores are aligned. Safe if dest is below src. The unaligned head and tail
+// are loaded first and stored last, as they may overlap the source.
+void copy_forward_sse2(char *dest, const char *src, size_t size) {
+	v16 head = load16(src);
+	v16 t0 = load16(src + size - 64);
+	v16 t1 = load16(src + size - 48);
+	v16 t2 = load16(src + size - 32);
+	v16 t3 = load16(src + size - 16);
+	char *start = dest;
+	char *tail = dest + size - 64;
+
+	size_t skip = 16 - (reinterpret_cast<uintptr_t>(dest) & 15);
+	dest += skip;
+	src += skip;
+	while(dest < tail) {
+		v16 a = load16(src);
+		v16 b = load16(src + 16);
+		v16 c = load16(src + 32);
+		v16 d = load16(src + 48);
+		store16(dest, a);
+		store16(dest + 16, b);
+		store16(dest + 32, c);
+		store16(dest + 48, d);
+		dest += 64;
+		src += 64;
+	}
+	store16(start, head);
+	store16(tail, t0);
+	store16(tail + 16, t1);
+	store16(tail + 32, t2);
+	store16(tail + 48, t3);
+}
+
+// Same as copy_forward_sse2() but from back to front. Safe if dest is above src.
+void copy_backward_sse2(char *dest, const char *src, size_t size) {
+	v16 tail = load16(src + size - 16);
+	v16 h0 = load16(src);
+	v16 h1 = load16(src + 16);
+	v16 h2 = load16(src + 32);
+	v16 h3 = load16(src + 48);
+	char *head = dest;
+
+	char *dest_end = dest + size;
+	const char *src_end = src + size;
+	char *last = dest_end - 16;
+	size_t skip = reinterpret_cast<uintptr_t>(dest_end) & 15;
+	if(!skip)
+		skip = 16;
+	dest_end -= skip;
+	src_end -= skip;
+	while(dest_end > head + 64) {
+		v16 a = load16(src_end - 16);
+		v16 b = load16(src_end - 32);
+		v16 c = load16(src_end - 48);
+		v16 d = load16(src_end - 64);
+		store16(dest_end - 16, a);
+		store16(dest_end - 32, b);
+		store16(dest_end - 48, c);
+		store16(dest_end - 64, d);
+		dest_end -= 64;
+		src_end -= 64;
+	}
+	store16(last, tail);
+	store16(head, h0);
+	store16(head + 16, h1);
+	store16(head + 32, h2);
+	store16(head + 48, h3);
+}
+
+__attribute__((__target__("avx2")))
+inline v32 load32(const char *p) {
+	return *reinterpret_cast<const v32 *>(p);
+}
+
+__attribute__((__target__("avx2")))
+inline void store32(char *p, v32 v) {
+	*reinterpret_cast<v32 *>(p) = v;
+}
+
+// AVX2 variant of copy_forward_sse2() in chunks of 128 bytes.
+__attribute__((__target__("avx2")))
+void copy_forward_avx2(char *dest, const char *src, size_t size) {
+	v32 head = load32(src);
+	v32 t0 = load32(src + size - 128);
+	v32 t1 = load32(src + size - 96);
+	v32 t2 = load32(src + size - 64);
+	v32 t3 = load32(src + size - 32);
+	char *start = dest;
+	char *tail = dest + size - 128;
+
+	size_t skip = 32 - (reinterpret_cast<uintptr_t>(dest) & 31);
+	dest += skip;
+	src += skip;
+	while(dest < tail) {
+		v32 a = load32(src);
+		v32 b = load32(src + 32);
+		v32 c = load32(src + 64);
+		v32 d = load32(src + 96);
+		store32(dest, a);
+		store32(dest + 32, b);
+		store32(dest + 64, c);
+		store32(dest + 96, d);
+		dest += 128;
+		src += 128;
+	}
+	store32(start, head);
+	store32(tail, t0);
+	store32(tail + 32, t1);
+	store32(tail + 64, t2);
+	store32(tail + 96, t3);
+}
+
+// Same as copy_forward_sse2() but with non-temporal stores.
+void copy_forward_stream(char *dest, const char *src, size_t size) {
+	v16 head = load16(src);
+	v16 t0 = load16(src + size - 64);
+	v16 t1 = load16(src + size - 48);
+	v16 t2 = load16(src + size - 32);
+	v16 t3 = load16(src + size - 16);
+	char *start = dest;
+	char *tail = dest + size - 64;
+
+	size_t skip = 16 - (reinterpret_cast<uintptr_t>(dest) & 15);
+	dest += skip;
+	src += skip;
+	while(dest < tail) {
+		v16 a = load16(src);
+		v16 b = load16(src + 16);
+		v16 c = load16(src + 32);
+		v16 d = load16(src + 48);
+		stream16(dest, a);
+		stream16(dest + 16, b);
+		stream16(dest + 32, c);
+		stream16(dest + 48, d);
+		dest += 64;
+		src += 64;
+	}
+	// Non-temporal stores are weakly ordered; order them before subsequent stores.
+	__builtin_ia32_sfence();
+	store16(start, head);
+	store16(tail, t0);
+	store16(tail + 16, t1);
+	store16(tail + 32, t2);
+	store16(tail + 48, t3);
+}
+
+void copy_forward(char *dest, const char *src, size_t size) {
+	auto &features = mlibc::getCpuFeatures();
+	if(size >= mlibc::getNonTemporalThreshold()) {
+		copy_forward_stream(dest, src, size);
+	}else if(size > rep_threshold && features.erms) {
+		asm volatile ("rep movsb" : "+D"(dest), "+S"(src), "+c"(size) : : "memory");
+	}else if(size > 256 && features.avx2) {
+		copy_forward_avx2(dest, src, size);
+	}else{
+		copy_forward_sse2(dest, src, size);
+	}
+}
+
+// Sets more than 128 bytes in chunks of 64 bytes.
+void set_large(char *dest, uint64_t pattern, size_t size) {
+	bool stream = size >= mlibc::getNonTemporalThreshold();
+	if(!stream && size > rep_threshold && mlibc::getCpuFeatures().erms) {
+		asm volatile ("rep stosb" : "+D"(dest), "+c"(size) : "a"(pattern) : "memory");
+		return;
+	}
+
+	v16 v = reinterpret_cast<v16>(v16_u64{pattern, pattern});
+	char *tail = dest + size - 64;
+	store16(dest, v);
+	dest += 16 - (reinterpret_cast<uintptr_t>(dest) & 15);
+	if(stream) {
+		while(dest < tail) {
+			stream16(dest, v);
+			stream16(dest + 16, v);
+			stream16(dest + 32, v);
+			stream16(dest + 48, v);
+			dest += 64;
+		}
+		__builtin_ia32_sfence();
+	}else{
+		while(dest < tail) {
+			store16(dest, v);
+			store16(dest + 16, v);
+			store16(dest + 32, v);
+			store16(dest + 48, v);
+			dest += 64;
+		}
+	}
+	store16(tail, v);
+	store16(tail + 16, v);
+	store16(tail + 32, v);
+	store16(tail + 48, v);
+}
+
+#else // defined(__x86_64__)
+
+// Copies word by word if dest and src have the same alignment.
+// Safe if dest is below src.
+void copy_forward(char *dest, const char *src, size_t size) {
+	if(!((reinterpret_cast<uintptr_t>(dest) ^ reinterpret_cast<uintptr_t>(src))
+			& (sizeof(word) - 1))) {
+		while(size && (reinterpret_cast<uintptr_t>(dest) & (sizeof(word) - 1))) {
+			*dest++ = *src++;
+			size--;
+		}
+		for(; size >= sizeof(word); size -= sizeof(word)) {
+			*reinterpret_cast<word *>(dest) = *reinterpret_cast<const word *>(src);
+			dest += sizeof(word);
+			src += sizeof(word);
+		}
+	}
+	while(size--)
+		*dest++ = *src++;
+}
+
+#endif // defined(__x86_64__)
+
+} // anonymous namespace
+
 void *memset(void *dest, int c, size_t size) {
-	char *dest_bytes = (char *)dest;
-	for(size_t i = 0; i < size; i++)
-		dest_bytes[i] = c;
+	auto dest_bytes = static_cast<char *>(dest);
+	uint64_t pattern = static_cast<unsigned char>(c) * UINT64_C(0x0101010101010101);
+	if(size <= 16) {
+		set_small(dest_bytes, pattern, size);
+		return dest;
+	}
+
+#if defined(__x86_64__)
+	if(size <= 128) {
+		v16 v = reinterpret_cast<v16>(v16_u64{pattern, pattern});
+		store16(dest_bytes, v);
+		store16(dest_bytes + size - 16, v);
+		if(size > 32) {
+			store16(dest_bytes + 16, v);
+			store16(dest_bytes + size - 32, v);
+		}
+		if(size > 64) {
+			store16(dest_bytes + 32, v);
+			store16(dest_bytes + 48, v);
+			store16(dest_bytes + size - 64, v);
+			store16(dest_bytes + size - 48, v);
+		}
+		return dest;
+	}
+	set_large(dest_bytes, pattern, size);
+#else
+	while(reinterpret_cast<uintptr_t>(dest_bytes) & (sizeof(word) - 1)) {
+		*dest_bytes++ = c;
+		size--;
+	}
+	for(; size >= sizeof(word); size -= sizeof(word)) {
+		*reinterpret_cast<word *>(dest_bytes) = static_cast<word>(pattern);
+		dest_bytes += sizeof(word);
+	}
+	set_small(dest_bytes, pattern, size);
+#endif
 	return dest;
 }
 
 void *memcpy(void *__restrict dest, const void *__restrict src, size_t size) {
-	char *dest_bytes = (char *)dest;
-	char *src_bytes = (char *)src;
-	for(size_t i = 0; i < size; i++)
-		dest_bytes[i] = src_bytes[i];
+	auto dest_bytes = static_cast<char *>(dest);
+	auto src_bytes = static_cast<const char *>(src);
+	if(size <= 16) {
+		copy_small(dest_bytes, src_bytes, size);
+		return dest;
+	}
+
+#if defined(__x86_64__)
+	if(size <= 128) {
+		copy_medium(dest_bytes, src_bytes, size);
+		return dest;
+	}
+#endif
+	copy_forward(dest_bytes, src_bytes, size);
 	return dest;
 }
 
 void *memmove(void *dest, const void *src, size_t size) {
-	char *dest_bytes = (char *)dest;
-	char *src_bytes = (char *)src;
-	if(dest_bytes < src_bytes) {
-		for(size_t i = 0; i < size; i++)
-			dest_bytes[i] = src_bytes[i];
+	auto dest_bytes = static_cast<char *>(dest);
+	auto src_bytes = static_cast<const char *>(src);
+	if(size <= 16) {
+		copy_small(dest_bytes, src_bytes, size);
+		return dest;
+	}
+
+#if defined(__x86_64__)
+	if(size <= 128) {
+		copy_medium(dest_bytes, src_bytes, size);
+		return dest;
+	}
+	// Copy front to back unless dest overlaps the end of src.
+	if(static_cast<size_t>(dest_bytes - src_bytes) >= size) {
+		// rep movsb is only fast if the buffers do not overlap.
+		if(static_cast<size_t>(src_bytes - dest_bytes) >= size) {
+			copy_forward(dest_bytes, src_bytes, size);
+		}else if(size >= mlibc::getNonTemporalThreshold()) {
+			copy_forward_stream(dest_bytes, src_bytes, size);
+		}else{
+			copy_forward_sse2(dest_bytes, src_bytes, size);
+		}
+	}else{
+		copy_backward_sse2(dest_bytes, src_bytes, size);
+	}
+#else
+	if(static_cast<size_t>(dest_bytes - src_bytes) >= size) {
+		copy_forward(dest_bytes, src_bytes, size);
 	}else{
-		for(size_t i = 0; i < size; i++)
-			dest_bytes[size - i - 1] = src_bytes[size - i - 1];
+		for(size_t i = size; i > 0; i--)
+			dest_bytes[i - 1] = src_bytes[i - 1];
 	}
+#endif
 	return dest;
 }
 
 size_t strlen(const char *s) {
-	size_t len = 0;
-	for(size_t i = 0; s[i]; i++)
-		len++;
-	return len;
+	auto start = reinterpret_cast<uintptr_t>(s);
+	return mlibc::byte_scan::find_first(start, UINTPTR_MAX, 0, false) - start;
 }
 
@@ -0,0 +1,340 @@
+
+#include <string.h>
+
+#include <bits/ensure.h>
+#include <mlibc/float-format.hpp>
+
+// Doubles are converted to decimal in one of two ways:
+// - If the scaled value m * 2^e * 10^f fits into 128 bits, it is computed
+//   by a single 128-bit multiplication (by a power of ten from a table)
+//   followed by a shift or division. This covers all "common" values.
+// - Otherwise, we compute the exact decimal expansion of the double using
+//   a big integer and round it afterwards.
+
+namespace mlibc {
+
+namespace {
+
+// Splits a (non-negative, finite) double into mantissa * 2^exponent.
+void decompose(double value, uint64_t &mantissa, int &exponent) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(double));
+	mantissa = bits & ((uint64_t(1) << 52) - 1);
+	int biased = (bits >> 52) & 0x7FF;
+	if(biased) {
+		mantissa |= uint64_t(1) << 52;
+		exponent = biased - 1075;
+	}else{
+		exponent = -1074;
+	}
+}
+
+void strip_trailing_zeros(float_digits &out) {
+	while(out.length && out.digits[out.length - 1] == '0')
+		out.length--;
+	if(!out.length)
+		out.exponent = 0;
+}
+
+// Rounds (ties to even) such that only the first keep digits remain.
+void round_digits(float_digits &out, int keep) {
+	if(keep >= out.length)
+		return;
+	if(keep < 0) {
+		out.length = 0;
+		out.exponent = 0;
+		return;
+	}
+
+	bool round_up;
+	if(out.digits[keep] != '5') {
+		round_up = out.digits[keep] > '5';
+	}else if(out.length > keep + 1) {
+		// As trailing zeros are not stored, the remaining digits are non-zero.
+		round_up = true;
+	}else{
+		round_up = keep && ((out.digits[keep - 1] - '0') & 1);
+	}
+
+	out.length = keep;
+	if(round_up) {
+		int i = keep - 1;
+		while(i >= 0 && out.digits[i] == '9')
+			i--;
+		if(i < 0) {
+			out.digits[0] = '1';
+			out.length = 1;
+			out.exponent++;
+		}else{
+			out.digits[i]++;
+			out.length = i + 1;
+		}
+	}
+	strip_trailing_zeros(out);
+}
+
+// Little-endian big integer that is large enough to hold mantissa * 5^1074.
+struct big_integer {
+	void multiply(uint32_t factor) {
+		uint64_t carry = 0;
+		for(int i = 0; i < size; i++) {
+			uint64_t product = uint64_t(limbs[i]) * factor + carry;
+			limbs[i] = product;
+			carry = product >> 32;
+		}
+		if(carry)
+			limbs[size++] = carry;
+	}
+
+	uint32_t divide(uint32_t divisor) {
+		uint64_t remainder = 0;
+		for(int i = size - 1; i >= 0; i--) {
+			uint64_t current = (remainder << 32) | limbs[i];
+			limbs[i] = current / divisor;
+			remainder = current % divisor;
+		}
+		while(size && !limbs[size - 1])
+			size--;
+		return remainder;
+	}
+
+	uint32_t limbs[84];
+	int size;
+};
+
+// Computes all digits of mantissa * 2^exponent.
+void exact_digits(uint64_t mantissa, int exponent, float_digits &out) {
+	big_integer n;
+	n.limbs[0] = mantissa;
+	n.limbs[1] = mantissa >> 32;
+	n.size = n.limbs[1] ? 2 : 1;
+
+	// For negative exponents, we compute the digits of mantissa * 5^-exponent
+	// and shift the decimal point to the left.
+	int shift = 0;
+	if(exponent >= 0) {
+		for(int k = exponent; k > 0; k -= 31)
+			n.multiply(uint32_t(1) << (k < 31 ? k : 31));
+	}else{
+		shift = -exponent;
+		int k = shift;
+		for(; k >= 13; k -= 13)
+			n.multiply(1220703125); // 5^13.
+		uint32_t factor = 1;
+		for(; k > 0; k--)
+			factor *= 5;
+		n.multiply(factor);
+	}
+
+	// Collect chunks of nine digits, least significant chunk first.
+	uint32_t chunks[88];
+	int num_chunks = 0;
+	while(n.size)
+		chunks[num_chunks++] = n.divide(1000000000);
+	__ensure(num_chunks);
+
+	char leading[10];
+	int leading_length = 0;
+	for(auto c = chunks[num_chunks - 1]; c; c /= 10)
+		leading[leading_length++] = '0' + c % 10;
+
+	out.length = 0;
+	while(leading_length)
+		out.digits[out.length++] = leading[--leading_length];
+	for(int i = num_chunks - 2; i >= 0; i--) {
+		auto c = chunks[i];
+		for(int j = 8; j >= 0; j--) {
+			out.digits[out.length + j] = '0' + c % 10;
+			c /= 10;
+		}
+		out.length += 9;
+	}
+	out.exponent = out.length - shift;
+	strip_trailing_zeros(out);
+}
+
+#ifdef __SIZEOF_INT128__
+
+using uint128 = unsigned __int128;
+
+struct pow10_table {
+	constexpr pow10_table()
+	: entries{} {
+		uint128 p = 1;
+		for(int i = 0; i < 39; i++) {
+			entries[i] = p;
+			p *= 10;
+		}
+	}
+
+	uint128 entries[39];
+};
+
+constexpr pow10_table pow10;
+
+// Computes q = floor(mantissa * 2^exponent * 10^scale) and determines whether
+// the exact value needs to be rounded up (ties to even).
+// Returns false if the computation does not fit into 128 bits.
+bool scale_128(uint64_t mantissa, int exponent, int scale, uint128 &q, bool &round_up) {
+	int mantissa_bits = 64 - __builtin_clzll(mantissa);
+
+	uint128 numerator = mantissa;
+	if(exponent >= 0) {
+		if(mantissa_bits + exponent > 127)
+			return false;
+		numerator <<= exponent;
+	}
+	if(scale >= 0) {
+		if(scale > 38 || __builtin_mul_overflow(numerator, pow10.entries[scale], &numerator))
+			return false;
+	}
+
+	if(exponent >= 0 && scale >= 0) {
+		q = numerator;
+		round_up = false;
+		return true;
+	}
+
+	// If the denominator is a power of two, we can avoid the division.
+	if(scale >= 0) {
+		int shift = -exponent;
+		if(shift > 127) {
+			// The numerator is less than 2^128; hence, the value is less than 1/2.
+			if(shift == 128)
+				return false;
+			q = 0;
+			round_up = false;
+			return true;
+		}
+		q = numerator >> shift;
+		uint128 remainder = numerator & ((uint128(1) << shift) - 1);
+		uint128 half = uint128(1) << (shift - 1);
+		round_up = remainder > half || (remainder == half && (q & 1));
+		return true;
+	}
+
+	uint128 denominator = 1;
+	if(exponent < 0) {
+		if(-exponent > 127)
+			return false;
+		denominator <<= -exponent;
+	}
+	if(-scale > 38 || __builtin_mul_overflow(denominator, pow10.entries[-scale], &denominator))
+		return false;
+
+	q = numerator / denominator;
+	uint128 remainder = numerator % denominator;
+	uint128 complement = denominator - remainder;
+	round_up = remainder > complement || (remainder == complement && (q & 1));
+	return true;
+}
+
+// Stores the digits of n * 10^-scale.
+void store_digits(uint128 n, int scale, float_digits &out) {
+	char buffer[40];
+	int length = 0;
+	while(n >> 64) {
+		// Split off the lower 19 digits to be able to work with 64-bit numbers.
+		constexpr uint64_t p19 = 10000000000000000000u;
+		auto low = uint64_t(n % p19);
+		n /= p19;
+		for(int j = 0; j < 19; j++) {
+			buffer[length++] = '0' + low % 10;
+			low /= 10;
+		}
+	}
+	for(auto low = uint64_t(n); low; low /= 10)
+		buffer[length++] = '0' + low % 10;
+
+	out.length = 0;
+	while(length)
+		out.digits[out.length++] = buffer[--length];
+	out.exponent = out.length - scale;
+	strip_trailing_zeros(out);
+}
+
+// Approximates floor(log10(2^e)) for |e| < 1650.
+int floor_log10_pow2(int e) {
+	return (e * 78913) >> 18;
+}
+
+#endif // defined(__SIZEOF_INT128__)
+
+} // anonymous namespace
+
+void binary_to_decimal(uint64_t mantissa, int exponent, float_digits &out) {
+	if(!mantissa) {
+		out.length = 0;
+		out.exponent = 0;
+		return;
+	}
+	exact_digits(mantissa, exponent, out);
+}
+
+void float_to_fixed(double value, int fraction_digits, float_digits &out) {
+	uint64_t mantissa;
+	int exponent;
+	decompose(value, mantissa, exponent);
+	if(!mantissa) {
+		out.length = 0;
+		out.exponent = 0;
+		return;
+	}
+
+#ifdef __SIZEOF_INT128__
+	uint128 q;
+	bool round_up;
+	if(scale_128(mantissa, exponent, fraction_digits, q, round_up)) {
+		store_digits(q + round_up, fraction_digits, out);
+		return;
+	}
+#endif
+
+	exact_digits(mantissa, exponent, out);
+	round_digits(out, out.exponent + fraction_digits);
+}
+
+void float_to_scientific(double value, int significant_digits, float_digits &out) {
+	__ensure(significant_digits > 0);
+
+	uint64_t mantissa;
+	int exponent;
+	decompose(value, mantissa, exponent);
+	if(!mantissa) {
+		out.length = 0;
+		out.exponent = 0;
+		return;
+	}
+
+#ifdef __SIZEOF_INT128__
+	if(significant_digits <= 38) {
+		// The decimal exponent is either the estimate or one larger;
+		// we detect this by checking the number of digits of the truncated value.
+		int binary_exponent = exponent + 63 - __builtin_clzll(mantissa);
+		int decimal_exponent = floor_log10_pow2(binary_exponent);
+		for(int attempt = 0; attempt < 3; attempt++) {
+			int scale = significant_digits - 1 - decimal_exponent;
+			uint128 q;
+			bool round_up;
+			if(!scale_128(mantissa, exponent, scale, q, round_up))
+				break;
+			if(q >= pow10.entries[significant_digits]) {
+				decimal_exponent++;
+				continue;
+			}
+			if(q < pow10.entries[significant_digits - 1]) {
+				decimal_exponent--;
+				continue;
+			}
+
+			store_digits(q + round_up, scale, out);
+			return;
+		}
+	}
+#endif
+
+	exact_digits(mantissa, exponent, out);
+	round_digits(out, significant_digits);
+}
+
+} // namespace mlibc
@@ -0,0 +1,250 @@
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <mlibc/byte-compare.hpp>
+#include <mlibc/byte-scan.hpp>
+#include <mlibc/substring-search.hpp>
+
+namespace mlibc {
+
+namespace {
+
+struct identity_fold {
+	unsigned char operator() (unsigned char c) const {
+		return c;
+	}
+};
+
+struct case_fold {
+	unsigned char operator() (unsigned char c) const {
+		return tolower(c);
+	}
+};
+
+// Haystack of known size.
+struct memory_haystack {
+	// Whether [p, p + n) is part of the haystack.
+	bool available(const unsigned char *p, size_t n) {
+		return static_cast<size_t>(end - p) >= n;
+	}
+
+	const unsigned char *end;
+};
+
+// Null-terminated haystack. Bytes before end are known to be part of the string;
+// we only scan for the terminator when the search needs more bytes.
+struct string_haystack {
+	bool available(const unsigned char *p, size_t n) {
+		if(static_cast<size_t>(end - p) >= n)
+			return true;
+		if(terminated)
+			return false;
+
+		// Look ahead in larger steps to avoid scanning the same bytes over and over.
+		size_t grow = (p + n - end) | 63;
+		auto z = byte_scan::find_first(reinterpret_cast<uintptr_t>(end),
+				byte_scan::limit_of(end, grow), 0, false);
+		if(z) {
+			end = reinterpret_cast<const unsigned char *>(z);
+			terminated = true;
+		}else{
+			end += grow;
+		}
+		return static_cast<size_t>(end - p) >= n;
+	}
+
+	const unsigned char *end;
+	bool terminated = false;
+};
+
+#if defined(__x86_64__)
+
+typedef char v16 __attribute__((__vector_size__(16), __aligned__(1), __may_alias__));
+
+inline v16 splat16(unsigned char c) {
+	char s = c;
+	return v16{s, s, s, s, s, s, s, s, s, s, s, s, s, s, s, s};
+}
+
+inline v16 load16(const unsigned char *p) {
+	return *reinterpret_cast<const v16 *>(p);
+}
+
+// Needles that are at most this long are handled by find_short().
+constexpr size_t short_needle = 16;
+
+// Checks 16 positions at once for matches of the first and the last byte of the needle;
+// only positions where both match are compared in full. As the needle is short,
+// this is still linear in the size of the haystack.
+template<typename Haystack>
+const unsigned char *find_short(const unsigned char *h, Haystack &hay,
+		const unsigned char *n, size_t l) {
+	v16 first = splat16(n[0]);
+	v16 last = splat16(n[l - 1]);
+	for(; hay.available(h, l - 1 + 16); h += 16) {
+		v16 hits = (v16)(load16(h) == first) & (v16)(load16(h + l - 1) == last);
+		uint32_t m = __builtin_ia32_pmovmskb128(hits);
+		while(m) {
+			auto c = h + __builtin_ctz(m);
+			if(l <= 2 || !byte_compare::differ(c + 1, n + 1, l - 2))
+				return c;
+			m &= m - 1;
+		}
+	}
+	for(; hay.available(h, l); h++) {
+		if(h[0] == n[0] && !byte_compare::differ(h, n, l))
+			return h;
+	}
+	return nullptr;
+}
+
+#endif // defined(__x86_64__)
+
+// Computes the start of the maximal suffix of the needle (w.r.t. the lexicographic order
+// or its reverse) and the period of that suffix.
+template<typename Fold>
+size_t maximal_suffix(const unsigned char *n, size_t l, Fold fold, bool reverse,
+		size_t &period) {
+	size_t i = SIZE_MAX; // Start of the current candidate minus one.
+	size_t j = 0;
+	size_t k = 1;
+	size_t p = 1;
+	while(j + k < l) {
+		unsigned char a = fold(n[i + k]);
+		unsigned char b = fold(n[j + k]);
+		if(a == b) {
+			if(k == p) {
+				j += p;
+				k = 1;
+			}else{
+				k++;
+			}
+		}else if(reverse ? a < b : a > b) {
+			j += k;
+			k = 1;
+			p = j - i;
+		}else{
+			i = j++;
+			k = p = 1;
+		}
+	}
+	period = p;
+	return i + 1;
+}
+
+// Two-Way string matching (Crochemore and Perrin), combined with a bad character shift
+// on the last byte of the window.
+template<typename Haystack, typename Fold>
+const unsigned char *find_two_way(const unsigned char *h, Haystack &hay,
+		const unsigned char *n, size_t l, Fold fold) {
+	// Distance of the last occurrence of each byte from the start of the needle (plus one).
+	size_t shift[256] = {};
+	for(size_t i = 0; i < l; i++)
+		shift[fold(n[i])] = i + 1;
+
+	// Critical factorization of the needle: the later of the two maximal suffixes.
+	size_t p, p_reverse;
+	size_t split = maximal_suffix(n, l, fold, false, p);
+	size_t split_reverse = maximal_suffix(n, l, fold, true, p_reverse);
+	if(split_reverse > split) {
+		split = split_reverse;
+		p = p_reverse;
+	}
+
+	// If the needle is periodic, we remember how much of it is already known to match
+	// after shifting by the period.
+	bool periodic = true;
+	for(size_t i = 0; i < split; i++) {
+		if(fold(n[i]) != fold(n[i + p])) {
+			periodic = false;
+			break;
+		}
+	}
+	size_t memory_after_shift = 0;
+	if(periodic) {
+		memory_after_shift = l - p;
+	}else{
+		p = split > l - split ? split : l - split + 1;
+	}
+
+	size_t memory = 0;
+	while(hay.available(h, l)) {
+		size_t k = l - shift[fold(h[l - 1])];
+		if(k) {
+			h += k < memory ? memory : k;
+			memory = 0;
+			continue;
+		}
+
+		// Compare the right part of the needle.
+		k = split > memory ? split : memory;
+		while(k < l && fold(n[k]) == fold(h[k]))
+			k++;
+		if(k < l) {
+			h += k - split + 1;
+			memory = 0;
+			continue;
+		}
+
+		// Compare the left part of the needle.
+		k = split;
+		while(k > memory && fold(n[k - 1]) == fold(h[k - 1]))
+			k--;
+		if(k <= memory)
+			return h;
+		h += p;
+		memory = memory_after_shift;
+	}
+	return nullptr;
+}
+
+template<typename Haystack>
+const unsigned char *find(const unsigned char *h, Haystack &hay,
+		const unsigned char *n, size_t l) {
+#if defined(__x86_64__)
+	if(l <= short_needle)
+		return find_short(h, hay, n, l);
+#endif
+	return find_two_way(h, hay, n, l, identity_fold{});
+}
+
+} // anonymous namespace
+
+const void *find_in_memory(const void *haystack, size_t haystack_size,
+		const void *needle, size_t needle_size) {
+	auto h = static_cast<const unsigned char *>(haystack);
+	auto n = static_cast<const unsigned char *>(needle);
+	if(!needle_size)
+		return haystack;
+	if(needle_size > haystack_size)
+		return nullptr;
+	if(needle_size == 1)
+		return memchr(haystack, n[0], haystack_size);
+
+	memory_haystack hay{h + haystack_size};
+	return find(h, hay, n, needle_size);
+}
+
+const char *find_in_string(const char *haystack, const char *needle, bool ignore_case) {
+	auto h = reinterpret_cast<const unsigned char *>(haystack);
+	auto n = reinterpret_cast<const unsigned char *>(needle);
+	if(!n[0])
+		return haystack;
+
+	if(ignore_case) {
+		string_haystack hay{h};
+		return reinterpret_cast<const char *>(find_two_way(h, hay, n, strlen(needle),
+				case_fold{}));
+	}
+
+	// Skip to the first candidate; this also handles needles of length one.
+	h = reinterpret_cast<const unsigned char *>(strchr(haystack, n[0]));
+	if(!h || !n[1])
+		return reinterpret_cast<const char *>(h);
+	string_haystack hay{h};
+	return reinterpret_cast<const char *>(find(h, hay, n, strlen(needle)));
+}
+
+} // namespace mlibc
@@ -0,0 +1,305 @@
+#ifndef MLIBC_BYTE_COMPARE_HPP
+#define MLIBC_BYTE_COMPARE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Kernels for comparing memory (used by memcmp(), bcmp(), strcmp() and strncmp()).
+// Ordering comparisons locate the first differing byte with a bitmask and return
+// the difference of that byte (as unsigned char); equality comparisons only
+// determine whether a difference exists.
+// The *_ignoring_case() variants fold ASCII letters to lower case; they are only
+// correct for charsets that are ASCII supersets.
+
+namespace mlibc {
+
+namespace byte_compare {
+
+// Maps 'A' to 'Z' to lower case and all other bytes to themselves.
+struct fold_table {
+	constexpr fold_table()
+	: map{} {
+		for(int i = 0; i < 256; i++)
+			map[i] = (i >= 'A' && i <= 'Z') ? i - 'A' + 'a' : i;
+	}
+
+	unsigned char map[256];
+};
+
+inline constexpr fold_table ascii_fold{};
+
+inline unsigned char fold(unsigned char c) {
+	return ascii_fold.map[c];
+}
+
+#if defined(__x86_64__)
+
+typedef char v16 __attribute__((__vector_size__(16), __aligned__(1), __may_alias__));
+typedef uint16_t __attribute__((__aligned__(1), __may_alias__)) unaligned_u16;
+typedef uint32_t __attribute__((__aligned__(1), __may_alias__)) unaligned_u32;
+typedef uint64_t __attribute__((__aligned__(1), __may_alias__)) unaligned_u64;
+
+inline v16 load16(const unsigned char *p) {
+	return *reinterpret_cast<const v16 *>(p);
+}
+
+inline uint32_t bits16(v16 v) {
+	return __builtin_ia32_pmovmskb128(v);
+}
+
+// Mask of the bytes that differ between the 16-byte blocks at a and b.
+inline uint32_t differences16(const unsigned char *a, const unsigned char *b) {
+	return bits16((v16)(load16(a) == load16(b))) ^ 0xFFFF;
+}
+
+// Compares n bytes (where n is between 1 and 16). On little endian, swapping the bytes
+// of two loaded words yields integers that compare like the bytes do.
+inline int compare_small(const unsigned char *a, const unsigned char *b, size_t n) {
+	if(n >= 8) {
+		uint64_t x = *reinterpret_cast<const unaligned_u64 *>(a);
+		uint64_t y = *reinterpret_cast<const unaligned_u64 *>(b);
+		if(x == y) {
+			x = *reinterpret_cast<const unaligned_u64 *>(a + n - 8);
+			y = *reinterpret_cast<const unaligned_u64 *>(b + n - 8);
+			if(x == y)
+				return 0;
+		}
+		return __builtin_bswap64(x) < __builtin_bswap64(y) ? -1 : 1;
+	}
+	if(n >= 4) {
+		uint32_t x = *reinterpret_cast<const unaligned_u32 *>(a);
+		uint32_t y = *reinterpret_cast<const unaligned_u32 *>(b);
+		if(x == y) {
+			x = *reinterpret_cast<const unaligned_u32 *>(a + n - 4);
+			y = *reinterpret_cast<const unaligned_u32 *>(b + n - 4);
+			if(x == y)
+				return 0;
+		}
+		return __builtin_bswap32(x) < __builtin_bswap32(y) ? -1 : 1;
+	}
+	for(size_t i = 0; i < n; i++) {
+		if(a[i] != b[i])
+			return a[i] - b[i];
+	}
+	return 0;
+}
+
+inline int compare(const void *a_ptr, const void *b_ptr, size_t n) {
+	auto a = static_cast<const unsigned char *>(a_ptr);
+	auto b = static_cast<const unsigned char *>(b_ptr);
+	if(n <= 16)
+		return compare_small(a, b, n);
+
+	size_t i = 0;
+	for(; i + 64 <= n; i += 64) {
+		v16 d = (load16(a + i) ^ load16(b + i)) | (load16(a + i + 16) ^ load16(b + i + 16))
+				| (load16(a + i + 32) ^ load16(b + i + 32))
+				| (load16(a + i + 48) ^ load16(b + i + 48));
+		if(bits16((v16)(d == v16{})) != 0xFFFF)
+			break;
+	}
+	for(; i + 16 <= n; i += 16) {
+		if(uint32_t m = differences16(a + i, b + i); m) {
+			size_t k = i + __builtin_ctz(m);
+			return a[k] - b[k];
+		}
+	}
+	// Check the last (overlapping) block.
+	if(i < n) {
+		i = n - 16;
+		if(uint32_t m = differences16(a + i, b + i); m) {
+			size_t k = i + __builtin_ctz(m);
+			return a[k] - b[k];
+		}
+	}
+	return 0;
+}
+
+// Returns zero iff the buffers are equal.
+inline int differ(const void *a_ptr, const void *b_ptr, size_t n) {
+	auto a = static_cast<const unsigned char *>(a_ptr);
+	auto b = static_cast<const unsigned char *>(b_ptr);
+	if(n < 16) {
+		// Combine two overlapping accesses; no need to locate the difference.
+		if(n >= 8)
+			return (*reinterpret_cast<const unaligned_u64 *>(a)
+					^ *reinterpret_cast<const unaligned_u64 *>(b))
+				| (*reinterpret_cast<const unaligned_u64 *>(a + n - 8)
+					^ *reinterpret_cast<const unaligned_u64 *>(b + n - 8)) ? 1 : 0;
+		if(n >= 4)
+			return (*reinterpret_cast<const unaligned_u32 *>(a)
+					^ *reinterpret_cast<const unaligned_u32 *>(b))
+				| (*reinterpret_cast<const unaligned_u32 *>(a + n - 4)
+					^ *reinterpret_cast<const unaligned_u32 *>(b + n - 4));
+		if(n >= 2)
+			return (*reinterpret_cast<const unaligned_u16 *>(a)
+					^ *reinterpret_cast<const unaligned_u16 *>(b))
+				| (*reinterpret_cast<const unaligned_u16 *>(a + n - 2)
+					^ *reinterpret_cast<const unaligned_u16 *>(b + n - 2));
+		return n ? *a ^ *b : 0;
+	}
+
+	v16 d = (load16(a) ^ load16(b)) | (load16(a + n - 16) ^ load16(b + n - 16));
+	for(size_t i = 16; i + 16 < n; i += 16) {
+		d |= load16(a + i) ^ load16(b + i);
+		// Stop early if we already found a difference, but do not check every block.
+		if(!(i & 63) && bits16((v16)(d == v16{})) != 0xFFFF)
+			return 1;
+	}
+	return bits16((v16)(d == v16{})) != 0xFFFF;
+}
+
+constexpr uintptr_t page_size = 4096;
+
+// Whether a 16-byte load at p stays within the page of p.
+inline bool block_fits_page(const unsigned char *p) {
+	return (reinterpret_cast<uintptr_t>(p) & (page_size - 1)) <= page_size - 16;
+}
+
+// Folds the ASCII letters in v to lower case. Bytes above 0x7F are negative and
+// hence, they are not affected.
+inline v16 fold16(v16 v) {
+	v16 upper = (v16)(v > (v16){} + ('A' - 1)) & (v16)(v < (v16){} + ('Z' + 1));
+	return v | (upper & ((v16){} + 0x20));
+}
+
+// Compares strings up to n bytes. Both strings are read in unaligned blocks of 16 bytes,
+// as long as these blocks do not cross a page boundary; at page boundaries, we fall back
+// to comparing single bytes.
+template<bool IgnoreCase>
+inline int compare_strings_impl(const char *a_ptr, const char *b_ptr, size_t n) {
+	auto a = reinterpret_cast<const unsigned char *>(a_ptr);
+	auto b = reinterpret_cast<const unsigned char *>(b_ptr);
+	size_t i = 0;
+	while(i < n) {
+		if(block_fits_page(a + i) && block_fits_page(b + i)) {
+			v16 x = load16(a + i);
+			v16 y = load16(b + i);
+			if(IgnoreCase) {
+				x = fold16(x);
+				y = fold16(y);
+			}
+			uint32_t m = bits16((v16)(x != y) | (v16)(x == v16{}));
+			if(n - i < 16)
+				m &= (uint32_t(1) << (n - i)) - 1;
+			if(m) {
+				size_t k = i + __builtin_ctz(m);
+				if(IgnoreCase)
+					return fold(a[k]) - fold(b[k]);
+				return a[k] - b[k];
+			}
+			i += 16;
+		}else{
+			unsigned char x = IgnoreCase ? fold(a[i]) : a[i];
+			unsigned char y = IgnoreCase ? fold(b[i]) : b[i];
+			if(x != y || !x)
+				return x - y;
+			i++;
+		}
+	}
+	return 0;
+}
+
+inline int compare_strings(const char *a, const char *b, size_t n) {
+	return compare_strings_impl<false>(a, b, n);
+}
+
+inline int compare_strings_ignoring_case(const char *a, const char *b, size_t n) {
+	return compare_strings_impl<true>(a, b, n);
+}
+
+#else // defined(__x86_64__)
+
+// Word-at-a-time fallback for buffers with the same alignment.
+typedef size_t __attribute__((__may_alias__)) word;
+
+constexpr word ones = static_cast<word>(0x0101010101010101);
+constexpr word highs = static_cast<word>(0x8080808080808080);
+
+inline bool same_alignment(const void *a, const void *b) {
+	return !((reinterpret_cast<uintptr_t>(a) ^ reinterpret_cast<uintptr_t>(b))
+			& (sizeof(word) - 1));
+}
+
+inline bool is_aligned(const void *p) {
+	return !(reinterpret_cast<uintptr_t>(p) & (sizeof(word) - 1));
+}
+
+// Skips the common prefix of whole words.
+inline size_t skip_equal_words(const unsigned char *a, const unsigned char *b, size_t n) {
+	size_t i = 0;
+	if(!same_alignment(a, b))
+		return 0;
+	while(i < n && !is_aligned(a + i) && a[i] == b[i])
+		i++;
+	if(!is_aligned(a + i))
+		return i;
+	while(i + sizeof(word) <= n && *reinterpret_cast<const word *>(a + i)
+			== *reinterpret_cast<const word *>(b + i))
+		i += sizeof(word);
+	return i;
+}
+
+inline int compare(const void *a_ptr, const void *b_ptr, size_t n) {
+	auto a = static_cast<const unsigned char *>(a_ptr);
+	auto b = static_cast<const unsigned char *>(b_ptr);
+	for(size_t i = skip_equal_words(a, b, n); i < n; i++) {
+		if(a[i] != b[i])
+			return a[i] - b[i];
+	}
+	return 0;
+}
+
+inline int differ(const void *a_ptr, const void *b_ptr, size_t n) {
+	auto a = static_cast<const unsigned char *>(a_ptr);
+	auto b = static_cast<const unsigned char *>(b_ptr);
+	for(size_t i = skip_equal_words(a, b, n); i < n; i++) {
+		if(a[i] != b[i])
+			return 1;
+	}
+	return 0;
+}
+
+inline int compare_strings(const char *a_ptr, const char *b_ptr, size_t n) {
+	auto a = reinterpret_cast<const unsigned char *>(a_ptr);
+	auto b = reinterpret_cast<const unsigned char *>(b_ptr);
+	size_t i = 0;
+	if(same_alignment(a, b)) {
+		for(; i < n && !is_aligned(a + i); i++) {
+			if(a[i] != b[i] || !a[i])
+				return a[i] - b[i];
+		}
+		// Aligned words never cross a page boundary.
+		for(; i + sizeof(word) <= n; i += sizeof(word)) {
+			word x = *reinterpret_cast<const word *>(a + i);
+			word y = *reinterpret_cast<const word *>(b + i);
+			if(x != y || ((x - ones) & ~x & highs))
+				break;
+		}
+	}
+	for(; i < n; i++) {
+		if(a[i] != b[i] || !a[i])
+			return a[i] - b[i];
+	}
+	return 0;
+}
+
+inline int compare_strings_ignoring_case(const char *a_ptr, const char *b_ptr, size_t n) {
+	auto a = reinterpret_cast<const unsigned char *>(a_ptr);
+	auto b = reinterpret_cast<const unsigned char *>(b_ptr);
+	for(size_t i = 0; i < n; i++) {
+		unsigned char x = fold(a[i]);
+		unsigned char y = fold(b[i]);
+		if(x != y || !x)
+			return x - y;
+	}
+	return 0;
+}
+
+#endif // defined(__x86_64__)
+
+} // namespace byte_compare
+
+} // namespace mlibc
+
+#endif // MLIBC_BYTE_COMPARE_HPP
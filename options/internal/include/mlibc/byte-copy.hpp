@@ -0,0 +1,97 @@
+#ifndef MLIBC_BYTE_COPY_HPP
+#define MLIBC_BYTE_COPY_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <mlibc/byte-scan.hpp>
+
+// Kernels for copying strings (used by strcpy(), strncpy(), strlcpy() etc.).
+// The terminator is located while copying, i.e., the source is only read once.
+// Loads from the source are aligned such that they never cross a page boundary.
+
+namespace mlibc {
+
+namespace byte_copy {
+
+// copy_string(dest, src, limit) copies the bytes of src before its terminator to dest,
+// but at most limit bytes. It returns the number of bytes that were copied;
+// the terminator is not written.
+
+#if defined(__x86_64__)
+
+typedef char unaligned_v16 __attribute__((__vector_size__(16), __aligned__(1), __may_alias__));
+
+inline size_t copy_string(char *dest, const char *src, size_t limit) {
+	using byte_scan::v16;
+	auto s = reinterpret_cast<uintptr_t>(src);
+
+	// src is not necessarily valid (e.g. strncpy(dest, src, 0)).
+	if(!limit)
+		return 0;
+
+	// The first aligned block may start before src.
+	uintptr_t p = s & ~uintptr_t(15);
+	uint32_t z = byte_scan::bits16((v16)(byte_scan::load16(p) == v16{})) >> (s - p);
+	size_t i = p + 16 - s;
+	if(z || i >= limit) {
+		size_t n = z ? __builtin_ctz(z) : i;
+		if(n > limit)
+			n = limit;
+		memcpy(dest, src, n);
+		return n;
+	}
+	memcpy(dest, src, i);
+
+	// Continue with whole blocks.
+	while(true) {
+		v16 v = byte_scan::load16(s + i);
+		z = byte_scan::bits16((v16)(v == v16{}));
+		if(z || limit - i <= 16) {
+			size_t n = z ? __builtin_ctz(z) : 16;
+			if(n > limit - i)
+				n = limit - i;
+			memcpy(dest + i, src + i, n);
+			return i + n;
+		}
+		*reinterpret_cast<unaligned_v16 *>(dest + i) = (unaligned_v16)v;
+		i += 16;
+	}
+}
+
+#else // defined(__x86_64__)
+
+typedef size_t __attribute__((__aligned__(1), __may_alias__)) unaligned_word;
+
+inline size_t copy_string(char *dest, const char *src, size_t limit) {
+	using byte_scan::word;
+	auto s = reinterpret_cast<uintptr_t>(src);
+	size_t i = 0;
+
+	// Copy single bytes until src is aligned.
+	for(; (s + i) & (sizeof(word) - 1); i++) {
+		if(i == limit || !src[i])
+			return i;
+		dest[i] = src[i];
+	}
+
+	for(; limit - i >= sizeof(word); i += sizeof(word)) {
+		word w = *reinterpret_cast<const word *>(src + i);
+		if(byte_scan::has_zero(w))
+			break;
+		*reinterpret_cast<unaligned_word *>(dest + i) = w;
+	}
+
+	for(; i < limit && src[i]; i++)
+		dest[i] = src[i];
+	return i;
+}
+
+#endif // defined(__x86_64__)
+
+} // namespace byte_copy
+
+} // namespace mlibc
+
+#endif // MLIBC_BYTE_COPY_HPP
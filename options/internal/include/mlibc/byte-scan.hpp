@@ -0,0 +1,238 @@
+#ifndef MLIBC_BYTE_SCAN_HPP
+#define MLIBC_BYTE_SCAN_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mlibc/cpu-features.hpp>
+
+// Kernels for locating bytes in memory (used by strlen(), memchr() etc.).
+// They only perform aligned loads: an aligned load never crosses a page boundary,
+// hence, it can read bytes before the start or after the end of the buffer without
+// faulting. Such bytes are ignored.
+
+namespace mlibc {
+
+namespace byte_scan {
+
+// find_first(start, limit, c, or_zero) returns the smallest address in [start, limit)
+// that contains a byte equal to c (or a null byte if or_zero is set) or zero if
+// no such address exists. Scanning beyond the end of a string is only safe if
+// or_zero is set or if c occurs in the string.
+//
+// find_last_in_string(s, c) and find_last(s, n, c) return the last occurrence of c
+// in a null-terminated string and in [s, s + n), respectively, or zero.
+
+#if defined(__x86_64__)
+
+typedef char v16 __attribute__((__vector_size__(16), __may_alias__));
+typedef char v32 __attribute__((__vector_size__(32), __may_alias__));
+
+inline v16 splat16(char c) {
+	return v16{c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c};
+}
+
+inline v16 load16(uintptr_t p) {
+	return *reinterpret_cast<const v16 *>(p);
+}
+
+inline uint32_t bits16(v16 v) {
+	return __builtin_ia32_pmovmskb128(v);
+}
+
+// Vector that is non-zero at the bytes of the aligned block at p that we are looking for.
+inline v16 hits16(uintptr_t p, v16 cv, bool or_zero) {
+	v16 v = load16(p);
+	v16 h = (v16)(v == cv);
+	if(or_zero)
+		h |= (v16)(v == v16{});
+	return h;
+}
+
+__attribute__((__target__("avx2")))
+inline v32 splat32(char c) {
+	return v32{c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c,
+			c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c};
+}
+
+__attribute__((__target__("avx2")))
+inline uint32_t bits32(v32 v) {
+	return __builtin_ia32_pmovmskb256(v);
+}
+
+__attribute__((__target__("avx2")))
+inline v32 hits32(uintptr_t p, v32 cv, bool or_zero) {
+	v32 v = *reinterpret_cast<const v32 *>(p);
+	v32 h = (v32)(v == cv);
+	if(or_zero)
+		h |= (v32)(v == v32{});
+	return h;
+}
+
+// Main loop of find_first() for 64-byte aligned p.
+__attribute__((__target__("avx2")))
+inline uintptr_t find_first_avx2(uintptr_t p, uintptr_t limit, char c, bool or_zero) {
+	v32 cv = splat32(c);
+	for(; p < limit; p += 64) {
+		v32 h0 = hits32(p, cv, or_zero);
+		v32 h1 = hits32(p + 32, cv, or_zero);
+		if(!bits32(h0 | h1))
+			continue;
+		uint64_t m = bits32(h0) | (uint64_t(bits32(h1)) << 32);
+		uintptr_t r = p + __builtin_ctzll(m);
+		return r < limit ? r : 0;
+	}
+	return 0;
+}
+
+inline uintptr_t find_first(uintptr_t start, uintptr_t limit, char c, bool or_zero) {
+	if(start >= limit)
+		return 0;
+	v16 cv = splat16(c);
+
+	// Check the block that contains start.
+	uintptr_t p = start & ~uintptr_t(15);
+	uint32_t m = bits16(hits16(p, cv, or_zero)) >> (start - p);
+	if(m) {
+		uintptr_t r = start + __builtin_ctz(m);
+		return r < limit ? r : 0;
+	}
+
+	// Continue block by block until p is 64-byte aligned. After that, we can check
+	// 64 bytes at once without crossing a page boundary.
+	for(p += 16; p & 63; p += 16) {
+		if(p >= limit)
+			return 0;
+		m = bits16(hits16(p, cv, or_zero));
+		if(m) {
+			uintptr_t r = p + __builtin_ctz(m);
+			return r < limit ? r : 0;
+		}
+	}
+
+	// The strings that make it here are long enough to amortize the feature check.
+	if(getCpuFeatures().avx2)
+		return find_first_avx2(p, limit, c, or_zero);
+
+	for(; p < limit; p += 64) {
+		v16 h0 = hits16(p, cv, or_zero);
+		v16 h1 = hits16(p + 16, cv, or_zero);
+		v16 h2 = hits16(p + 32, cv, or_zero);
+		v16 h3 = hits16(p + 48, cv, or_zero);
+		if(!bits16(h0 | h1 | h2 | h3))
+			continue;
+		uint64_t m = bits16(h0) | (bits16(h1) << 16)
+				| (uint64_t(bits16(h2)) << 32) | (uint64_t(bits16(h3)) << 48);
+		uintptr_t r = p + __builtin_ctzll(m);
+		return r < limit ? r : 0;
+	}
+	return 0;
+}
+
+// The terminator counts as part of the string.
+inline uintptr_t find_last_in_string(uintptr_t s, char c) {
+	v16 cv = splat16(c);
+	uintptr_t last = 0;
+	uintptr_t p = s & ~uintptr_t(15);
+	uint32_t valid = 0xFFFF << (s - p);
+	while(true) {
+		v16 v = load16(p);
+		uint32_t cm = bits16((v16)(v == cv)) & valid;
+		uint32_t zm = bits16((v16)(v == v16{})) & valid;
+		if(zm) {
+			// Only consider bytes up to (and including) the terminator.
+			cm &= zm ^ (zm - 1);
+			if(cm)
+				last = p + 31 - __builtin_clz(cm);
+			return last;
+		}
+		if(cm)
+			last = p + 31 - __builtin_clz(cm);
+		p += 16;
+		valid = 0xFFFF;
+	}
+}
+
+inline uintptr_t find_last(uintptr_t s, size_t n, char c) {
+	if(!n)
+		return 0;
+	v16 cv = splat16(c);
+	uintptr_t end = s + n;
+	uintptr_t p = (end - 1) & ~uintptr_t(15);
+	uint32_t m = bits16((v16)(load16(p) == cv)) & ((uint32_t(1) << (end - p)) - 1);
+	while(true) {
+		if(p < s)
+			m &= ~uint32_t(0) << (s - p);
+		if(m)
+			return p + 31 - __builtin_clz(m);
+		if(p <= s)
+			return 0;
+		p -= 16;
+		m = bits16((v16)(load16(p) == cv));
+	}
+}
+
+#else // defined(__x86_64__)
+
+// Word-at-a-time fallback.
+typedef size_t __attribute__((__may_alias__)) word;
+
+constexpr word ones = static_cast<word>(0x0101010101010101);
+constexpr word highs = static_cast<word>(0x8080808080808080);
+
+// Non-zero iff one of the bytes of x is zero.
+inline word has_zero(word x) {
+	return (x - ones) & ~x & highs;
+}
+
+inline uintptr_t find_first(uintptr_t start, uintptr_t limit, char c, bool or_zero) {
+	word cw = ones * static_cast<unsigned char>(c);
+	uintptr_t p = start & ~uintptr_t(sizeof(word) - 1);
+	for(; p < limit; p += sizeof(word)) {
+		word x = *reinterpret_cast<const word *>(p);
+		if(!has_zero(x ^ cw) && !(or_zero && has_zero(x)))
+			continue;
+		for(uintptr_t q = p < start ? start : p; q < p + sizeof(word); q++) {
+			if(q >= limit)
+				return 0;
+			char b = *reinterpret_cast<const char *>(q);
+			if(b == c || (or_zero && !b))
+				return q;
+		}
+	}
+	return 0;
+}
+
+inline uintptr_t find_last_in_string(uintptr_t s, char c) {
+	uintptr_t last = 0;
+	for(auto p = reinterpret_cast<const char *>(s); ; p++) {
+		if(*p == c)
+			last = reinterpret_cast<uintptr_t>(p);
+		if(!*p)
+			return last;
+	}
+}
+
+inline uintptr_t find_last(uintptr_t s, size_t n, char c) {
+	auto p = reinterpret_cast<const char *>(s);
+	while(n) {
+		n--;
+		if(p[n] == c)
+			return s + n;
+	}
+	return 0;
+}
+
+#endif // defined(__x86_64__)
+
+// Returns start + n, saturated to the end of the address space.
+inline uintptr_t limit_of(const void *start, size_t n) {
+	auto s = reinterpret_cast<uintptr_t>(start);
+	return n > UINTPTR_MAX - s ? UINTPTR_MAX : s + n;
+}
+
+} // namespace byte_scan
+
+} // namespace mlibc
+
+#endif // MLIBC_BYTE_SCAN_HPP
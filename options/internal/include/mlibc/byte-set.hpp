@@ -0,0 +1,108 @@
+#ifndef MLIBC_BYTE_SET_HPP
+#define MLIBC_BYTE_SET_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mlibc/byte-scan.hpp>
+
+// Kernels for scanning strings for sets of bytes (used by strspn(), strcspn(),
+// strpbrk(), strtok() etc.). The set is given as a null-terminated string; it is
+// converted to a bitmap once per call such that each byte of the input only
+// requires a table lookup. Small sets are checked by vector compares instead.
+
+namespace mlibc {
+
+namespace byte_set {
+
+// span(s, set, accept) returns the length of the initial segment of s that consists
+// of bytes in the set (if accept is set) or of bytes not in the set (otherwise).
+// In both cases, the segment ends at the null-terminator of s.
+
+struct bitmap {
+	static constexpr size_t word_bits = 8 * sizeof(size_t);
+
+	void insert(unsigned char c) {
+		words[c / word_bits] |= size_t(1) << (c % word_bits);
+	}
+
+	bool contains(unsigned char c) const {
+		return words[c / word_bits] & (size_t(1) << (c % word_bits));
+	}
+
+	size_t words[256 / word_bits] = {};
+};
+
+#if defined(__x86_64__)
+
+using byte_scan::v16;
+using byte_scan::bits16;
+using byte_scan::load16;
+using byte_scan::splat16;
+
+// Sets that are at most this large are handled by span_small().
+constexpr size_t small_set = 4;
+
+// Like byte_scan::find_first(), this only performs aligned loads.
+inline size_t span_small(const char *s, const char *set, size_t k, bool accept) {
+	// Repeating a member of the set does not change the result.
+	v16 c0 = splat16(set[0]);
+	v16 c1 = splat16(set[k > 1 ? 1 : 0]);
+	v16 c2 = splat16(set[k > 2 ? 2 : 0]);
+	v16 c3 = splat16(set[k > 3 ? 3 : 0]);
+
+	auto start = reinterpret_cast<uintptr_t>(s);
+	uintptr_t p = start & ~uintptr_t(15);
+	uint32_t valid = 0xFFFF << (start - p);
+	while(true) {
+		v16 v = load16(p);
+		uint32_t m = bits16((v16)(v == c0) | (v16)(v == c1) | (v16)(v == c2) | (v16)(v == c3));
+		// The null byte is never a member of the set.
+		uint32_t stop = accept ? ~m & 0xFFFF : m | bits16((v16)(v == v16{}));
+		stop &= valid;
+		if(stop)
+			return p + __builtin_ctz(stop) - start;
+		p += 16;
+		valid = 0xFFFF;
+	}
+}
+
+#endif // defined(__x86_64__)
+
+inline size_t span(const char *s, const char *set, bool accept) {
+	if(!set[0])
+		return accept ? 0 : byte_scan::find_first(reinterpret_cast<uintptr_t>(s),
+				UINTPTR_MAX, 0, true) - reinterpret_cast<uintptr_t>(s);
+	if(!set[1] && !accept)
+		return byte_scan::find_first(reinterpret_cast<uintptr_t>(s),
+				UINTPTR_MAX, set[0], true) - reinterpret_cast<uintptr_t>(s);
+
+	size_t k = 1;
+	while(set[k])
+		k++;
+#if defined(__x86_64__)
+	if(k <= small_set)
+		return span_small(s, set, k, accept);
+#endif
+
+	bitmap bm;
+	for(size_t i = 0; i < k; i++)
+		bm.insert(set[i]);
+	auto u = reinterpret_cast<const unsigned char *>(s);
+	size_t n = 0;
+	if(accept) {
+		while(bm.contains(u[n]))
+			n++;
+	}else{
+		bm.insert(0);
+		while(!bm.contains(u[n]))
+			n++;
+	}
+	return n;
+}
+
+} // namespace byte_set
+
+} // namespace mlibc
+
+#endif // MLIBC_BYTE_SET_HPP
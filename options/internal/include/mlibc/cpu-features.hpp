@@ -0,0 +1,36 @@
+#ifndef MLIBC_CPU_FEATURES_HPP
+#define MLIBC_CPU_FEATURES_HPP
+
+#include <stddef.h>
+
+namespace mlibc {
+
+// Optional instruction set extensions that our kernels can take advantage of.
+// Vector extensions are only reported if the OS saves the corresponding register state.
+struct cpu_features {
+	bool sse42;
+	bool avx;
+	bool avx2;
+	bool bmi2;
+	bool erms; // Enhanced rep movsb/stosb.
+	bool fsrm; // Fast short rep movsb.
+	bool avx512f;
+	bool avx512bw;
+	bool avx512vl;
+
+	size_t cache_size; // Size of the last-level cache in bytes (zero if unknown).
+};
+
+// Detects the features on first use (exactly once, even if threads race). This neither
+// depends on relocations nor on global constructors, hence, it can be called from IFUNC resolvers.
+const cpu_features &getCpuFeatures();
+
+// Copies and fills that are at least this large use non-temporal stores, such that
+// they do not evict the working set from the cache. Defaults to 3/4 of the last-level
+// cache; SIZE_MAX disables non-temporal stores. The threshold must not be zero.
+size_t getNonTemporalThreshold();
+void setNonTemporalThreshold(size_t threshold);
+
+} // namespace mlibc
+
+#endif // MLIBC_CPU_FEATURES_HPP
@@ -0,0 +1,184 @@
+#ifndef MLIBC_FLOAT_FORMAT_HPP
+#define MLIBC_FLOAT_FORMAT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <frg/printf.hpp>
+
+namespace mlibc {
+
+// Decimal representation of a non-negative, finite double.
+// The represented value is 0.D * 10^exponent where D are the digits.
+// Trailing zeros are never stored; a length of zero represents the value zero.
+struct float_digits {
+	// The exact expansion of a double has at most 767 significant digits.
+	char digits[800];
+	int length;
+	int exponent;
+};
+
+// Converts the value to decimal and rounds it (ties to even)
+// to the given number of digits after the decimal point.
+void float_to_fixed(double value, int fraction_digits, float_digits &out);
+
+// Converts the value to decimal and rounds it (ties to even)
+// to the given number of significant digits (which needs to be positive).
+void float_to_scientific(double value, int significant_digits, float_digits &out);
+
+// Computes the exact decimal representation of mantissa * 2^exponent.
+// Used by strtod() to round correctly.
+void binary_to_decimal(uint64_t mantissa, int exponent, float_digits &out);
+
+// Appends digits [from, from + count) of d. Digits outside of the stored range are zero.
+template<typename F>
+void append_float_digits(F &formatter, const float_digits &d, int from, int count) {
+	const char *zeros = "00000000000000000000000000000000";
+	while(count > 0) {
+		int n;
+		if(from >= 0 && from < d.length) {
+			n = d.length - from;
+			if(n > count)
+				n = count;
+			formatter.append(d.digits + from, n);
+		}else{
+			n = count < 32 ? count : 32;
+			if(from < 0 && n > -from)
+				n = -from;
+			formatter.append(zeros, n);
+		}
+		from += n;
+		count -= n;
+	}
+}
+
+// Implements the %f, %F, %e, %E, %g and %G conversions.
+template<typename F>
+void do_printf_floats(F &formatter, char t, frg::format_options opts,
+		frg::printf_size_mod, frg::va_struct *vsp) {
+	auto value = va_arg(vsp->args, double);
+	bool upper = t == 'F' || t == 'E' || t == 'G';
+	int precision = opts.precision ? *opts.precision : 6;
+
+	char sign = 0;
+	if(__builtin_signbit(value)) {
+		sign = '-';
+		value = -value;
+	}else if(opts.always_sign) {
+		sign = '+';
+	}else if(opts.plus_becomes_space) {
+		sign = ' ';
+	}
+
+	auto pad = [&] (char c, int n) {
+		for(int i = 0; i < n; i++)
+			formatter.append(c);
+	};
+
+	// Infinities and NaNs are never padded with zeros.
+	if(__builtin_isinf(value) || __builtin_isnan(value)) {
+		const char *s;
+		if(__builtin_isinf(value)) {
+			s = upper ? "INF" : "inf";
+		}else{
+			s = upper ? "NAN" : "nan";
+		}
+		int total = 3 + (sign ? 1 : 0);
+		if(!opts.left_justify)
+			pad(' ', opts.minimum_width - total);
+		if(sign)
+			formatter.append(sign);
+		formatter.append(s, 3);
+		if(opts.left_justify)
+			pad(' ', opts.minimum_width - total);
+		return;
+	}
+
+	float_digits d;
+	bool exp_style;
+	int fraction; // Number of digits after the decimal point.
+	if(t == 'f' || t == 'F') {
+		float_to_fixed(value, precision, d);
+		exp_style = false;
+		fraction = precision;
+	}else if(t == 'e' || t == 'E') {
+		if(value) {
+			float_to_scientific(value, precision + 1, d);
+		}else{
+			d.length = 0;
+			d.exponent = 1;
+		}
+		exp_style = true;
+		fraction = precision;
+	}else{
+		int p = precision ? precision : 1;
+		if(value) {
+			float_to_scientific(value, p, d);
+		}else{
+			d.length = 0;
+			d.exponent = 1;
+		}
+		int x = d.exponent - 1;
+		if(p > x && x >= -4) {
+			exp_style = false;
+			fraction = p - 1 - x;
+			if(!opts.alt_conversion && fraction > d.length - d.exponent)
+				fraction = d.length > d.exponent ? d.length - d.exponent : 0;
+		}else{
+			exp_style = true;
+			fraction = p - 1;
+			if(!opts.alt_conversion && fraction > d.length - 1)
+				fraction = d.length ? d.length - 1 : 0;
+		}
+	}
+	bool point = fraction > 0 || opts.alt_conversion;
+
+	// Prepare the exponent of the exponential style.
+	char exp_buffer[8];
+	int exp_length = 0;
+	if(exp_style) {
+		int x = d.exponent - 1;
+		exp_buffer[exp_length++] = upper ? 'E' : 'e';
+		exp_buffer[exp_length++] = x < 0 ? '-' : '+';
+		if(x < 0)
+			x = -x;
+		if(x >= 100)
+			exp_buffer[exp_length++] = '0' + x / 100;
+		exp_buffer[exp_length++] = '0' + (x / 10) % 10;
+		exp_buffer[exp_length++] = '0' + x % 10;
+	}
+
+	int integral = (exp_style || d.exponent < 1) ? 1 : d.exponent;
+	int total = (sign ? 1 : 0) + integral + (point ? 1 : 0) + fraction + exp_length;
+
+	if(!opts.left_justify && !opts.fill_zeros)
+		pad(' ', opts.minimum_width - total);
+	if(sign)
+		formatter.append(sign);
+	if(!opts.left_justify && opts.fill_zeros)
+		pad('0', opts.minimum_width - total);
+
+	if(exp_style) {
+		append_float_digits(formatter, d, 0, 1);
+		if(point)
+			formatter.append('.');
+		append_float_digits(formatter, d, 1, fraction);
+		formatter.append(exp_buffer, exp_length);
+	}else{
+		if(d.exponent > 0) {
+			append_float_digits(formatter, d, 0, d.exponent);
+		}else{
+			formatter.append('0');
+		}
+		if(point)
+			formatter.append('.');
+		append_float_digits(formatter, d, d.exponent, fraction);
+	}
+
+	if(opts.left_justify)
+		pad(' ', opts.minimum_width - total);
+}
+
+} // namespace mlibc
+
+#endif // MLIBC_FLOAT_FORMAT_HPP
@@ -0,0 +1,94 @@
+#ifndef MLIBC_INT_FORMAT_HPP
+#define MLIBC_INT_FORMAT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace mlibc {
+
+// "00", "01", ..., "99" without separators.
+extern const char digit_pairs[];
+
+// Maximal number of characters that the functions below produce for 64-bit values.
+inline constexpr int max_integer_digits = 20;
+
+inline int count_decimal_digits(uint64_t value) {
+	int n = 1;
+	while(true) {
+		if(value < 10)
+			return n;
+		if(value < 100)
+			return n + 1;
+		if(value < 1000)
+			return n + 2;
+		if(value < 10000)
+			return n + 3;
+		value /= 10000;
+		n += 4;
+	}
+}
+
+inline int count_hex_digits(uint64_t value) {
+	if(!value)
+		return 1;
+	return (64 - __builtin_clzll(value) + 3) / 4;
+}
+
+// Writes exactly n decimal digits of value to the end of [.., end).
+// The caller ensures that value has at most n digits.
+inline void write_decimal_backwards(char *end, uint64_t value, int n) {
+	// Use 32-bit arithmetic as soon as possible; 64-bit division is slow on 32-bit targets.
+	while(value > UINT32_MAX) {
+		auto r = value % 100;
+		value /= 100;
+		end -= 2;
+		end[0] = digit_pairs[2 * r];
+		end[1] = digit_pairs[2 * r + 1];
+		n -= 2;
+	}
+	auto v = static_cast<uint32_t>(value);
+	while(n >= 2) {
+		auto r = v % 100;
+		v /= 100;
+		end -= 2;
+		end[0] = digit_pairs[2 * r];
+		end[1] = digit_pairs[2 * r + 1];
+		n -= 2;
+	}
+	if(n)
+		*(--end) = '0' + v;
+}
+
+// Writes value in decimal (padded with zeros to min_digits) to buffer and returns
+// the number of characters written. No null terminator is written.
+inline int format_decimal(char *buffer, uint64_t value, int min_digits = 1) {
+	int n = count_decimal_digits(value);
+	if(n < min_digits)
+		n = min_digits;
+	write_decimal_backwards(buffer + n, value, n);
+	return n;
+}
+
+inline int format_signed_decimal(char *buffer, int64_t value, int min_digits = 1) {
+	if(value < 0) {
+		*buffer = '-';
+		return 1 + format_decimal(buffer + 1, -static_cast<uint64_t>(value), min_digits);
+	}
+	return format_decimal(buffer, value, min_digits);
+}
+
+inline int format_hex(char *buffer, uint64_t value, bool upper = false, int min_digits = 1) {
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	int n = count_hex_digits(value);
+	if(n < min_digits)
+		n = min_digits;
+	for(int i = n - 1; i >= 0; i--) {
+		buffer[i] = digits[value & 0xF];
+		value >>= 4;
+	}
+	return n;
+}
+
+} // namespace mlibc
+
+#endif // MLIBC_INT_FORMAT_HPP
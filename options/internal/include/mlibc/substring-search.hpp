@@ -0,0 +1,21 @@
+#ifndef MLIBC_SUBSTRING_SEARCH_HPP
+#define MLIBC_SUBSTRING_SEARCH_HPP
+
+#include <stddef.h>
+
+namespace mlibc {
+
+// Substring search engine (used by strstr(), strcasestr() and memmem()).
+// Both functions return the first occurrence of the needle or nullptr.
+// Short needles are located by a vectorized prefilter; longer needles use the
+// Two-Way algorithm, which runs in linear time and constant space.
+
+const void *find_in_memory(const void *haystack, size_t haystack_size,
+		const void *needle, size_t needle_size);
+
+// The end of the haystack is only determined as far as the search requires it.
+const char *find_in_string(const char *haystack, const char *needle, bool ignore_case);
+
+} // namespace mlibc
+
+#endif // MLIBC_SUBSTRING_SEARCH_HPP
@@ -16,6 +16,7 @@
 #	include <bits/posix/stat.h>
 #	include <poll.h>
 #	include <stdarg.h>
+#	include <stdint.h>
 #	include <sys/epoll.h>
 #	include <sys/socket.h>
 #	include <sys/resource.h>
@@ -113,6 +114,11 @@ int sys_close(int fd);
 	[[gnu::weak]] int sys_ttyname(int fd, char *buf, size_t size);
 	[[gnu::weak]] int sys_fadvise(int fd, off_t offset, off_t length, int advice);
 	[[gnu::weak]] int sys_fsync(int fd);
+	// Asynchronous write at the current file position. The data must remain valid
+	// until sys_write_async_wait() returns for the same ticket.
+	[[gnu::weak]] int sys_write_async(int fd, const void *buffer, size_t size,
+			uint64_t *ticket);
+	[[gnu::weak]] int sys_write_async_wait(uint64_t ticket, ssize_t *bytes_written);
 #endif // !defined(MLIBC_BUILDING_RTDL)
 
 int sys_vm_map(void *hint, size_t size, int prot, int flags, int fd, off_t offset, void **window);
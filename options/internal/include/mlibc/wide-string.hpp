@@ -0,0 +1,256 @@
+#ifndef MLIBC_WIDE_STRING_HPP
+#define MLIBC_WIDE_STRING_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <bits/wchar_t.h>
+
+#include <mlibc/cpu-features.hpp>
+
+// Kernels for wide strings (used by wcslen(), wcschr(), wcscmp(), wmemset() etc.).
+// They follow the byte kernels in <mlibc/byte-scan.hpp> and <mlibc/byte-compare.hpp>
+// but operate on 32-bit lanes. Wide strings are aligned to sizeof(wchar_t), hence,
+// an aligned vector load never covers a partial wide character.
+
+namespace mlibc {
+
+namespace wide_string {
+
+// find_first(start, limit, c, or_zero) returns the smallest address in [start, limit)
+// that contains a wide character equal to c (or a null character if or_zero is set)
+// or zero if no such address exists.
+//
+// find_last_in_string(s, c) returns the last occurrence of c in a null-terminated
+// wide string (the terminator counts as part of the string) or zero.
+//
+// compare_strings(a, b, n) compares at most n wide characters of a and b.
+//
+// fill(dest, c, n) sets n wide characters to c.
+
+#if defined(__x86_64__)
+
+static_assert(sizeof(wchar_t) == 4, "wide_string kernels expect 32-bit wchar_t");
+
+typedef char v16_bytes __attribute__((__vector_size__(16), __may_alias__));
+typedef int32_t v16 __attribute__((__vector_size__(16), __may_alias__));
+typedef int32_t unaligned_v16 __attribute__((__vector_size__(16), __aligned__(1), __may_alias__));
+typedef char v32_bytes __attribute__((__vector_size__(32), __may_alias__));
+typedef int32_t v32 __attribute__((__vector_size__(32), __may_alias__));
+
+inline v16 splat16(wchar_t c) {
+	return v16{c, c, c, c};
+}
+
+inline v16 load16(uintptr_t p) {
+	return *reinterpret_cast<const v16 *>(p);
+}
+
+// Each lane contributes four bits to the mask; hence, the index of the lowest bit
+// is the byte offset of the lane.
+inline uint32_t bits16(v16 v) {
+	return __builtin_ia32_pmovmskb128((v16_bytes)v);
+}
+
+inline v16 hits16(uintptr_t p, v16 cv, bool or_zero) {
+	v16 v = load16(p);
+	v16 h = (v16)(v == cv);
+	if(or_zero)
+		h |= (v16)(v == v16{});
+	return h;
+}
+
+__attribute__((__target__("avx2")))
+inline uint32_t bits32(v32 v) {
+	return __builtin_ia32_pmovmskb256((v32_bytes)v);
+}
+
+__attribute__((__target__("avx2")))
+inline v32 hits32(uintptr_t p, wchar_t c, bool or_zero) {
+	v32 v = *reinterpret_cast<const v32 *>(p);
+	v32 h = (v32)(v == (v32{} + c));
+	if(or_zero)
+		h |= (v32)(v == v32{});
+	return h;
+}
+
+// Main loop of find_first() for 64-byte aligned p.
+__attribute__((__target__("avx2")))
+inline uintptr_t find_first_avx2(uintptr_t p, uintptr_t limit, wchar_t c, bool or_zero) {
+	for(; p < limit; p += 64) {
+		v32 h0 = hits32(p, c, or_zero);
+		v32 h1 = hits32(p + 32, c, or_zero);
+		if(!bits32(h0 | h1))
+			continue;
+		uint64_t m = bits32(h0) | (uint64_t(bits32(h1)) << 32);
+		uintptr_t r = p + __builtin_ctzll(m);
+		return r < limit ? r : 0;
+	}
+	return 0;
+}
+
+inline uintptr_t find_first(uintptr_t start, uintptr_t limit, wchar_t c, bool or_zero) {
+	if(start >= limit)
+		return 0;
+	v16 cv = splat16(c);
+
+	// Check the block that contains start.
+	uintptr_t p = start & ~uintptr_t(15);
+	uint32_t m = bits16(hits16(p, cv, or_zero)) >> (start - p);
+	if(m) {
+		uintptr_t r = start + __builtin_ctz(m);
+		return r < limit ? r : 0;
+	}
+
+	// Continue block by block until p is 64-byte aligned.
+	for(p += 16; p & 63; p += 16) {
+		if(p >= limit)
+			return 0;
+		m = bits16(hits16(p, cv, or_zero));
+		if(m) {
+			uintptr_t r = p + __builtin_ctz(m);
+			return r < limit ? r : 0;
+		}
+	}
+
+	if(getCpuFeatures().avx2)
+		return find_first_avx2(p, limit, c, or_zero);
+
+	for(; p < limit; p += 64) {
+		v16 h0 = hits16(p, cv, or_zero);
+		v16 h1 = hits16(p + 16, cv, or_zero);
+		v16 h2 = hits16(p + 32, cv, or_zero);
+		v16 h3 = hits16(p + 48, cv, or_zero);
+		if(!bits16(h0 | h1 | h2 | h3))
+			continue;
+		uint64_t m = bits16(h0) | (bits16(h1) << 16)
+				| (uint64_t(bits16(h2)) << 32) | (uint64_t(bits16(h3)) << 48);
+		uintptr_t r = p + __builtin_ctzll(m);
+		return r < limit ? r : 0;
+	}
+	return 0;
+}
+
+inline uintptr_t find_last_in_string(uintptr_t s, wchar_t c) {
+	v16 cv = splat16(c);
+	uintptr_t last = 0;
+	uintptr_t p = s & ~uintptr_t(15);
+	uint32_t valid = 0xFFFF << (s - p);
+	while(true) {
+		v16 v = load16(p);
+		uint32_t cm = bits16((v16)(v == cv)) & valid;
+		uint32_t zm = bits16((v16)(v == v16{})) & valid;
+		if(zm) {
+			// Only consider lanes up to (and including) the terminator.
+			cm &= zm ^ (zm - 1);
+			if(cm)
+				last = p + ((31 - __builtin_clz(cm)) & ~3);
+			return last;
+		}
+		if(cm)
+			last = p + ((31 - __builtin_clz(cm)) & ~3);
+		p += 16;
+		valid = 0xFFFF;
+	}
+}
+
+// Whether a 16-byte load at p stays within the page of p.
+inline bool block_fits_page(const wchar_t *p) {
+	return (reinterpret_cast<uintptr_t>(p) & 4095) <= 4096 - 16;
+}
+
+inline int compare_strings(const wchar_t *a, const wchar_t *b, size_t n) {
+	size_t i = 0;
+	while(i < n) {
+		if(block_fits_page(a + i) && block_fits_page(b + i)) {
+			v16 x = *reinterpret_cast<const unaligned_v16 *>(a + i);
+			v16 y = *reinterpret_cast<const unaligned_v16 *>(b + i);
+			uint32_t m = bits16((v16)(x != y) | (v16)(x == v16{}));
+			if(n - i < 4)
+				m &= (uint32_t(1) << (4 * (n - i))) - 1;
+			if(m) {
+				size_t k = i + __builtin_ctz(m) / 4;
+				if(a[k] == b[k])
+					return 0;
+				return a[k] < b[k] ? -1 : 1;
+			}
+			i += 4;
+		}else{
+			if(a[i] != b[i])
+				return a[i] < b[i] ? -1 : 1;
+			if(!a[i])
+				return 0;
+			i++;
+		}
+	}
+	return 0;
+}
+
+inline void fill(wchar_t *dest, wchar_t c, size_t n) {
+	if(n < 4) {
+		for(size_t i = 0; i < n; i++)
+			dest[i] = c;
+		return;
+	}
+	v16 v = splat16(c);
+	wchar_t *end = dest + n;
+	// The unaligned head and tail overlap the aligned stores in between.
+	*reinterpret_cast<unaligned_v16 *>(dest) = v;
+	auto p = reinterpret_cast<wchar_t *>((reinterpret_cast<uintptr_t>(dest) + 16)
+			& ~uintptr_t(15));
+	for(; p + 4 <= end; p += 4)
+		*reinterpret_cast<v16 *>(p) = v;
+	*reinterpret_cast<unaligned_v16 *>(end - 4) = v;
+}
+
+#else // defined(__x86_64__)
+
+inline uintptr_t find_first(uintptr_t start, uintptr_t limit, wchar_t c, bool or_zero) {
+	for(auto p = reinterpret_cast<const wchar_t *>(start);
+			reinterpret_cast<uintptr_t>(p) < limit; p++) {
+		if(*p == c || (or_zero && !*p))
+			return reinterpret_cast<uintptr_t>(p);
+	}
+	return 0;
+}
+
+inline uintptr_t find_last_in_string(uintptr_t s, wchar_t c) {
+	uintptr_t last = 0;
+	for(auto p = reinterpret_cast<const wchar_t *>(s); ; p++) {
+		if(*p == c)
+			last = reinterpret_cast<uintptr_t>(p);
+		if(!*p)
+			return last;
+	}
+}
+
+inline int compare_strings(const wchar_t *a, const wchar_t *b, size_t n) {
+	for(size_t i = 0; i < n; i++) {
+		if(a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+		if(!a[i])
+			return 0;
+	}
+	return 0;
+}
+
+inline void fill(wchar_t *dest, wchar_t c, size_t n) {
+	for(size_t i = 0; i < n; i++)
+		dest[i] = c;
+}
+
+#endif // defined(__x86_64__)
+
+// Returns the address behind n wide characters at start, saturated to the end of
+// the address space.
+inline uintptr_t limit_of(const wchar_t *start, size_t n) {
+	auto s = reinterpret_cast<uintptr_t>(start);
+	if(n > (UINTPTR_MAX - s) / sizeof(wchar_t))
+		return UINTPTR_MAX;
+	return s + n * sizeof(wchar_t);
+}
+
+} // namespace wide_string
+
+} // namespace mlibc
+
+#endif // MLIBC_WIDE_STRING_HPP
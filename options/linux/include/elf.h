@@ -88,7 +88,8 @@ enum {
 enum {
 	STT_OBJECT = 1,
 	STT_FUNC = 2,
-	STT_TLS = 6
+	STT_TLS = 6,
+	STT_GNU_IFUNC = 10
 };
 
 enum {
@@ -100,6 +101,11 @@ enum {
 	R_X86_64_DTPMOD64 = 16,
 	R_X86_64_DTPOFF64 = 17,
 	R_X86_64_TPOFF64 = 18,
+	R_X86_64_IRELATIVE = 37,
+};
+
+enum {
+	R_386_IRELATIVE = 42
 };
 
 struct Elf64_Rela {
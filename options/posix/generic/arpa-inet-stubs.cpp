@@ -1,6 +1,10 @@
 
 #include <arpa/inet.h>
+#include <errno.h>
+#include <string.h>
+
 #include <bits/ensure.h>
+#include <mlibc/int-format.hpp>
 
 namespace {
 
@@ -40,9 +44,9 @@ in_addr_t inet_addr(const char *) {
 	__ensure(!"Not implemented");
 	__builtin_unreachable();
 }
-char *inet_ntoa(struct in_addr) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
+char *inet_ntoa(struct in_addr addr) {
+	static thread_local char buffer[INET_ADDRSTRLEN];
+	return const_cast<char *>(inet_ntop(AF_INET, &addr, buffer, INET_ADDRSTRLEN));
 }
 int inet_aton(const char *, struct in_addr *) {
 	__ensure(!"Not implemented");
@@ -52,10 +56,74 @@ int inet_aton(const char *, struct in_addr *) {
 // ----------------------------------------------------------------------------
 // Generic IP address manipulation.
 // ----------------------------------------------------------------------------
-const char *inet_ntop(int, const void *__restrict, char *__restrict,
-		socklen_t) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
+const char *inet_ntop(int af, const void *__restrict src, char *__restrict dst,
+		socklen_t size) {
+	char buffer[INET6_ADDRSTRLEN];
+	int n = 0;
+	if(af == AF_INET) {
+		auto bytes = reinterpret_cast<const uint8_t *>(src);
+		for(int i = 0; i < 4; i++) {
+			if(i)
+				buffer[n++] = '.';
+			n += mlibc::format_decimal(buffer + n, bytes[i]);
+		}
+	}else if(af == AF_INET6) {
+		auto bytes = reinterpret_cast<const struct in6_addr *>(src)->s6_addr;
+		uint16_t words[8];
+		for(int i = 0; i < 8; i++)
+			words[i] = (bytes[2 * i] << 8) | bytes[2 * i + 1];
+
+		// Find the longest run (of at least two) zero words; it is replaced by "::".
+		int run_start = -1, run_length = 1;
+		for(int i = 0; i < 8; ) {
+			if(words[i]) {
+				i++;
+				continue;
+			}
+			int j = i;
+			while(j < 8 && !words[j])
+				j++;
+			if(j - i > run_length) {
+				run_start = i;
+				run_length = j - i;
+			}
+			i = j;
+		}
+
+		for(int i = 0; i < 8; i++) {
+			if(i == run_start) {
+				buffer[n++] = ':';
+				if(i + run_length == 8)
+					buffer[n++] = ':';
+				i += run_length - 1;
+				continue;
+			}
+			if(i)
+				buffer[n++] = ':';
+			// IPv4-mapped addresses end in dotted decimal notation.
+			if(i == 6 && run_start == 0 && (run_length == 6
+					|| (run_length == 5 && words[5] == 0xFFFF))) {
+				for(int k = 12; k < 16; k++) {
+					if(k != 12)
+						buffer[n++] = '.';
+					n += mlibc::format_decimal(buffer + n, bytes[k]);
+				}
+				break;
+			}
+			n += mlibc::format_hex(buffer + n, words[i]);
+		}
+	}else{
+		errno = EAFNOSUPPORT;
+		return nullptr;
+	}
+
+	if(static_cast<socklen_t>(n) >= size) {
+		errno = ENOSPC;
+		return nullptr;
+	}
+	memcpy(dst, buffer, n);
+	dst[n] = 0;
+	return dst;
 }
 int inet_pton(int, const char *__restrict, void *__restrict) {
 	__ensure(!"Not implemented");
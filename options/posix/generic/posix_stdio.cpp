@@ -2,14 +2,52 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <abi-bits/abi.h>
 #include <bits/ensure.h>
+#include <frg/allocation.hpp>
+#include <mlibc/allocator.hpp>
 #include <mlibc/debug.hpp>
 #include <mlibc/file-io.hpp>
 
-FILE *fmemopen(void *__restrict, size_t, const char *__restrict) {
-	__ensure(!"Not implemented");
-	__builtin_unreachable();
+FILE *fmemopen(void *__restrict buffer, size_t size, const char *__restrict mode) {
+	int flags;
+	if(*mode == 'r') {
+		flags = __MLIBC_O_RDONLY;
+	}else if(*mode == 'w') {
+		flags = __MLIBC_O_WRONLY | __MLIBC_O_TRUNC;
+	}else if(*mode == 'a') {
+		flags = __MLIBC_O_WRONLY | __MLIBC_O_APPEND;
+	}else{
+		errno = EINVAL;
+		return nullptr;
+	}
+	if(strchr(mode, '+'))
+		flags = (flags & ~__MLIBC_O_ACCMODE) | __MLIBC_O_RDWR;
+
+	if(!size) {
+		errno = EINVAL;
+		return nullptr;
+	}
+
+	// If no buffer is given, we allocate one that is freed on fclose().
+	bool owns_memory = false;
+	if(!buffer) {
+		buffer = getAllocator().allocate(size);
+		if(!buffer) {
+			errno = ENOMEM;
+			return nullptr;
+		}
+		memset(buffer, 0, size);
+		owns_memory = true;
+	}
+
+	return frg::construct<mlibc::mem_file>(mlibc::getFileAllocator(),
+			reinterpret_cast<char *>(buffer), size, flags, owns_memory,
+			[] (mlibc::abstract_file *abstract) {
+				frg::destruct(mlibc::getFileAllocator(), abstract);
+			});
 }
 
 int pclose(FILE *) {
@@ -22,11 +60,20 @@ FILE *popen(const char*, const char *) {
 	__builtin_unreachable();
 }
 
-FILE *open_memstream(char **, size_t *) {
-	mlibc::infoLogger() << "\e[31mmlibc: open_memstream() always fails"
-			<< "\e[39m" << frg::endlog;
-	errno = ENOMEM;
-	return nullptr;
+FILE *open_memstream(char **ptr, size_t *sizeloc) {
+	// The buffer is passed to the user, so it has to be compatible with free().
+	constexpr size_t initial_capacity = 64;
+	auto memory = reinterpret_cast<char *>(malloc(initial_capacity));
+	if(!memory) {
+		errno = ENOMEM;
+		return nullptr;
+	}
+
+	return frg::construct<mlibc::memstream_file>(mlibc::getFileAllocator(),
+			ptr, sizeloc, memory, initial_capacity,
+			[] (mlibc::abstract_file *abstract) {
+				frg::destruct(mlibc::getFileAllocator(), abstract);
+			});
 }
 
 int fseeko(FILE *file_base, off_t offset, int whence) {
@@ -48,3 +95,14 @@ off_t ftello(FILE *file_base) {
 	return current_offset;
 }
 
+FILE *fopencookie(void *__restrict cookie, const char *__restrict mode,
+		cookie_io_functions_t io_funcs) {
+	// Missing callbacks already determine which operations are possible;
+	// the mode does not need to be tracked separately.
+	(void)mode;
+
+	return frg::construct<mlibc::cookie_file>(mlibc::getFileAllocator(), cookie, io_funcs,
+			[] (mlibc::abstract_file *abstract) {
+				frg::destruct(mlibc::getFileAllocator(), abstract);
+			});
+}
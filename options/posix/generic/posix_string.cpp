@@ -4,6 +4,8 @@
 #include <string.h>
 #include <signal.h>
 
+#include <mlibc/byte-scan.hpp>
+#include <mlibc/byte-set.hpp>
 #include <mlibc/debug.hpp>
 
 char *strdup(const char *string) {
@@ -19,9 +21,8 @@ char *strdup(const char *string) {
 }
 
 char *strndup(const char *string, size_t max_size) {
-	auto num_bytes = strlen(string);
-	if(num_bytes > max_size)
-		num_bytes = max_size;
+	// Do not read beyond max_size bytes; string does not need to be null-terminated.
+	auto num_bytes = strnlen(string, max_size);
 
 	char *new_string = (char *)malloc(num_bytes + 1);
 	if(!new_string) // TODO: set errno
@@ -33,14 +34,11 @@ char *strndup(const char *string, size_t max_size) {
 }
 
 size_t strnlen(const char *s, size_t n) {
-	__ensure(n >= 0);
-	size_t len = 0;
-	for(size_t i = 0; s[i]; i++) {
-		if(len == n)
-			break;
-		len++;
-	}
-	return len;
+	auto start = reinterpret_cast<uintptr_t>(s);
+	auto p = mlibc::byte_scan::find_first(start, mlibc::byte_scan::limit_of(s, n), 0, false);
+	if(!p)
+		return n;
+	return p - start;
 }
 
 char *strtok_r(char *__restrict s, const char *__restrict del, char **__restrict m) {
@@ -57,16 +55,16 @@ char *strtok_r(char *__restrict s, const char *__restrict del, char **__restrict
 	}
 
 	// Skip initial delimiters.
-	// After this loop: *tok is non-null iff we return a token.
-	while(*tok && strchr(del, *tok))
-		tok++;
-	
+	// After this: *tok is non-null iff we return a token.
+	tok += mlibc::byte_set::span(tok, del, true);
+	if(!*tok) {
+		*m = nullptr;
+		return nullptr;
+	}
+
 	// Replace the following delimiter by a null-terminator.
-	// After this loop: *p is null iff we reached the end of the string.
-	auto p = tok;
-	while(*p && !strchr(del, *p))
-		p++;
-	
+	// After this: *p is null iff we reached the end of the string.
+	auto p = tok + mlibc::byte_set::span(tok, del, false);
 	if(*p) {
 		*p = 0;
 		*m = p + 1;
@@ -84,11 +82,8 @@ char *strsep(char **m, const char *del) {
 		return nullptr;
 
 	// Replace the following delimiter by a null-terminator.
-	// After this loop: *p is null iff we reached the end of the string.
-	auto p = tok;
-	while(*p && !strchr(del, *p))
-		p++;
-	
+	// After this: *p is null iff we reached the end of the string.
+	auto p = tok + mlibc::byte_set::span(tok, del, false);
 	if(*p) {
 		*p = 0;
 		*m = p + 1;
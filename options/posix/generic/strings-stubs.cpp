@@ -3,6 +3,13 @@
 
 #include <ctype.h>
 #include <bits/ensure.h>
+#include <mlibc/byte-compare.hpp>
+#include <mlibc/charset.hpp>
+
+// Unlike memcmp(), bcmp() only needs to detect whether a difference exists.
+int bcmp(const void *a, const void *b, size_t size) {
+	return mlibc::byte_compare::differ(a, b, size);
+}
 
 int ffs(int word) {
 	__ensure(!"Not implemented");
@@ -10,22 +17,14 @@ int ffs(int word) {
 }
 
 int strcasecmp(const char *a, const char *b) {
-	size_t i = 0;
-	while(true) {
-		unsigned char a_byte = tolower(a[i]);
-		unsigned char b_byte = tolower(b[i]);
-		if(!a_byte && !b_byte)
-			return 0;
-		// If only one char is null, one of the following cases applies.
-		if(a_byte < b_byte)
-			return -1;
-		if(a_byte > b_byte)
-			return 1;
-		i++;
-	}
+	return strncasecmp(a, b, SIZE_MAX);
 }
 
 int strncasecmp(const char *a, const char *b, size_t size) {
+	// Fast path: fold bytes by table lookups or vector operations instead of tolower().
+	if(mlibc::current_charset()->is_ascii_superset())
+		return mlibc::byte_compare::compare_strings_ignoring_case(a, b, size);
+
 	for(size_t i = 0; i < size; i++) {
 		unsigned char a_byte = tolower(a[i]);
 		unsigned char b_byte = tolower(b[i]);
@@ -39,4 +38,3 @@ int strncasecmp(const char *a, const char *b, size_t size) {
 	}
 	return 0;
 }
-
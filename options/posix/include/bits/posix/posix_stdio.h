@@ -24,6 +24,22 @@ FILE *open_memstream(char **, size_t *);
 int fseeko(FILE *stream, off_t offset, int whence);
 off_t ftello(FILE *stream);
 
+// GNU extensions.
+
+typedef ssize_t cookie_read_function_t(void *, char *, size_t);
+typedef ssize_t cookie_write_function_t(void *, const char *, size_t);
+typedef int cookie_seek_function_t(void *, off_t *, int);
+typedef int cookie_close_function_t(void *);
+
+typedef struct {
+	cookie_read_function_t *read;
+	cookie_write_function_t *write;
+	cookie_seek_function_t *seek;
+	cookie_close_function_t *close;
+} cookie_io_functions_t;
+
+FILE *fopencookie(void *__restrict, const char *__restrict, cookie_io_functions_t);
+
 #ifdef __cplusplus
 }
 #endif
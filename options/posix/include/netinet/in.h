@@ -52,9 +52,9 @@ struct ipv6_mreq {
 #define INADDR_BROADCAST ((in_addr_t)0xffffffff)
 #define INADDR_LOOPBACK ((in_addr_t)0x7f000001)
 
-#define INET_ADDRSTRLEN 1
+#define INET_ADDRSTRLEN 16
 
-#define INET6_ADDRSTRLEN 1
+#define INET6_ADDRSTRLEN 46
 
 #define IPV6_JOIN_GROUP 1
 #define IPV6_LEAVE_GROUP 2
@@ -295,8 +295,13 @@ void ObjectRepository::_fetchFromFile(SharedObject *object, int fd) {
 
 				// Clear the trailing area at the end of the backed mapping.
 				// We do not clear the leading area; programs are not supposed to access it.
+				// The anonymous mapping behind the backed mapping is already zero;
+				// touching it would only fault in pages that the program might never use.
+				auto bss_size = phdr->p_memsz - phdr->p_filesz;
+				if(bss_size > backed_map_size - misalign - phdr->p_filesz)
+					bss_size = backed_map_size - misalign - phdr->p_filesz;
 				memset(reinterpret_cast<void *>(map_address + misalign + phdr->p_filesz),
-						0, phdr->p_memsz - phdr->p_filesz);
+						0, bss_size);
 			#else
 				(void)backed_map_size;
 
@@ -611,6 +616,13 @@ uintptr_t ObjectSymbol::virtualAddress() {
 	return _object->baseAddress + _symbol->st_value;
 }
 
+uintptr_t ObjectSymbol::resolvedAddress() {
+	auto address = virtualAddress();
+	if(ELF64_ST_TYPE(_symbol->st_info) == STT_GNU_IFUNC)
+		address = reinterpret_cast<uintptr_t (*)()>(address)();
+	return address;
+}
+
 // --------------------------------------------------------
 // Scope
 // --------------------------------------------------------
@@ -784,25 +796,27 @@ void Loader::linkObjects() {
 		_globalScope->appendObject(*it);
 	}
 
-	// Process regular relocations.
-	for(auto it = _linkBfs.begin(); it != _linkBfs.end(); ++it) {
+	// Process regular relocations. We link in reverse BFS order, such that dependencies
+	// (e.g. the libc) are usually relocated before we call their IFUNC resolvers.
+	for(size_t i = _linkBfs.size(); i > 0; i--) {
+		auto object = _linkBfs[i - 1];
 		// Some objects have already been linked before.
-		if((*it)->objectRts < _linkRts)
+		if(object->objectRts < _linkRts)
 			continue;
 
 		if(verbose)
-			mlibc::infoLogger() << "rtdl: Linking " << (*it)->name << frg::endlog;
+			mlibc::infoLogger() << "rtdl: Linking " << object->name << frg::endlog;
 
-		__ensure(!(*it)->wasLinked);
-		(*it)->loadScope = _globalScope;
+		__ensure(!object->wasLinked);
+		object->loadScope = _globalScope;
 
 		// TODO: Support this.
-		if((*it)->symbolicResolution)
+		if(object->symbolicResolution)
 			mlibc::infoLogger() << "\e[31mrtdl: DT_SYMBOLIC is not implemented correctly!\e[39m"
 					<< frg::endlog;
 
-		_processStaticRelocations(*it);
-		_processLazyRelocations(*it);
+		_processStaticRelocations(object);
+		_processLazyRelocations(object);
 	}
 	
 	// Process copy relocations.
@@ -973,19 +987,26 @@ void Loader::_processRela(SharedObject *object, Elf64_Rela *reloc) {
 	switch(type) {
 	case R_X86_64_64: {
 		__ensure(symbol_index);
-		uint64_t symbol_addr = p ? p->virtualAddress() : 0;
+		uint64_t symbol_addr = p ? p->resolvedAddress() : 0;
 		*((uint64_t *)rel_addr) = symbol_addr + reloc->r_addend;
 	} break;
 	case R_X86_64_GLOB_DAT: {
 		__ensure(symbol_index);
 		__ensure(!reloc->r_addend);
-		uint64_t symbol_addr = p ? p->virtualAddress() : 0;
+		uint64_t symbol_addr = p ? p->resolvedAddress() : 0;
 		*((uint64_t *)rel_addr) = symbol_addr;
 	} break;
 	case R_X86_64_RELATIVE: {
 		__ensure(!symbol_index);
 		*((uint64_t *)rel_addr) = object->baseAddress + reloc->r_addend;
 	} break;
+	// IRELATIVE stores the result of an IFUNC resolver in the same object.
+	// The linker emits these relocations after all other relocations of the table.
+	case R_X86_64_IRELATIVE: {
+		__ensure(!symbol_index);
+		auto resolver = reinterpret_cast<uintptr_t (*)()>(object->baseAddress + reloc->r_addend);
+		*((uint64_t *)rel_addr) = resolver();
+	} break;
 	// DTPMOD and DTPOFF are dynamic TLS relocations (for __tls_get_addr()).
 	// TPOFF is a relocation to the initial TLS model.
 	case R_X86_64_DTPMOD64: {
@@ -1083,6 +1104,10 @@ void Loader::_processLazyRelocations(SharedObject *object) {
 		Elf64_Xword symbol_index = ELF64_R_SYM(reloc->r_info);
 		uintptr_t rel_addr = object->baseAddress + reloc->r_offset;
 
+		// IFUNCs that are local to the object; they are resolved below.
+		if(type == R_X86_64_IRELATIVE)
+			continue;
+
 		__ensure(type == R_X86_64_JUMP_SLOT);
 		if(eagerBinding) {
 			auto symbol = (Elf64_Sym *)(object->baseAddress + object->symbolTableOffset
@@ -1099,11 +1124,19 @@ void Loader::_processLazyRelocations(SharedObject *object) {
 							<< r.getString() << " in object " << object->name << frg::endlog;
 				*((uint64_t *)rel_addr) = 0;
 			}else{
-				*((uint64_t *)rel_addr) = p->virtualAddress();
+				*((uint64_t *)rel_addr) = p->resolvedAddress();
 			}
 		}else{
 			*((uint64_t *)rel_addr) += object->baseAddress;
 		}
 	}
+
+	// Call the resolvers only after all JUMP_SLOTs are set up,
+	// as the resolvers may call functions through the PLT.
+	for(size_t offset = 0; offset < object->lazyTableSize; offset += sizeof(Elf64_Rela)) {
+		auto reloc = (Elf64_Rela *)(object->baseAddress + object->lazyRelocTableOffset + offset);
+		if(ELF64_R_TYPE(reloc->r_info) == R_X86_64_IRELATIVE)
+			_processRela(object, reloc);
+	}
 }
 
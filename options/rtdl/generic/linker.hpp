@@ -165,6 +165,10 @@ struct ObjectSymbol {
 	
 	uintptr_t virtualAddress();
 
+	// Address that references to the symbol bind to.
+	// For IFUNC symbols, this calls the resolver.
+	uintptr_t resolvedAddress();
+
 private:
 	SharedObject *_object;
 	const Elf64_Sym *_symbol;
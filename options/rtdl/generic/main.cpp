@@ -54,10 +54,22 @@ extern "C" void relocateSelf() {
 		case R_X86_64_RELATIVE:
 			*p = ldso_base + reloc->r_addend;
 			break;
+		case R_X86_64_IRELATIVE:
+			// Resolved below, as the resolvers depend on the other relocations.
+			break;
 		default:
 			__builtin_trap();
 		}
 	}
+
+	for(size_t disp = 0; disp < rela_size; disp += sizeof(Elf64_Rela)) {
+		auto reloc = reinterpret_cast<Elf64_Rela *>(ldso_base + rela_offset + disp);
+		if(ELF64_R_TYPE(reloc->r_info) != R_X86_64_IRELATIVE)
+			continue;
+
+		auto resolver = reinterpret_cast<uint64_t (*)()>(ldso_base + reloc->r_addend);
+		*reinterpret_cast<uint64_t *>(ldso_base + reloc->r_offset) = resolver();
+	}
 }
 
 extern "C" void *lazyRelocate(SharedObject *object, unsigned int rel_index) {
@@ -79,8 +91,9 @@ extern "C" void *lazyRelocate(SharedObject *object, unsigned int rel_index) {
 	//mlibc::infoLogger() << "Lazy relocation to " << symbol_str
 	//		<< " resolved to " << pointer << frg::endlog;
 	
-	*(uint64_t *)(object->baseAddress + reloc->r_offset) = p->virtualAddress();
-	return (void *)p->virtualAddress();
+	auto address = p->resolvedAddress();
+	*(uint64_t *)(object->baseAddress + reloc->r_offset) = address;
+	return (void *)address;
 }
 
 extern "C" [[ gnu::visibility("default") ]] void __rtdl_setupTcb() {
@@ -298,7 +311,7 @@ void *__dlapi_resolve(void *handle, const char *string) {
 	}
 
 	__ensure(target);
-	return reinterpret_cast<void *>(target->virtualAddress());
+	return reinterpret_cast<void *>(target->resolvedAddress());
 }
 
 struct __dlapi_symbol {
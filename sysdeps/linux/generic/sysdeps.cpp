@@ -1,4 +1,5 @@
 #include <errno.h>
+#include <stdint.h>
 #include <type_traits>
 
 #include <bits/ensure.h>
@@ -16,6 +17,8 @@
 #define NR_mmap 9
 #define NR_exit 60
 #define NR_arch_prctl 158
+#define NR_io_uring_setup 425
+#define NR_io_uring_enter 426
 
 #define ARCH_SET_FS	0x1002
 
@@ -112,6 +115,222 @@ void sys_exit(int status) {
 int sys_futex_wait(int *pointer, int expected) STUB_ONLY
 int sys_futex_wake(int *pointer) STUB_ONLY
 
+// --------------------------------------------------------------------------------------
+// Asynchronous writes via io_uring.
+// --------------------------------------------------------------------------------------
+
+namespace {
+	// Kernel ABI of io_uring (see linux/io_uring.h).
+	struct io_sqring_offsets {
+		uint32_t head, tail, ring_mask, ring_entries, flags, dropped, array, resv1;
+		uint64_t resv2;
+	};
+
+	struct io_cqring_offsets {
+		uint32_t head, tail, ring_mask, ring_entries, overflow, cqes, flags, resv1;
+		uint64_t resv2;
+	};
+
+	struct io_uring_params {
+		uint32_t sq_entries, cq_entries, flags, sq_thread_cpu, sq_thread_idle,
+				features, wq_fd, resv[3];
+		io_sqring_offsets sq_off;
+		io_cqring_offsets cq_off;
+	};
+
+	struct io_uring_sqe {
+		uint8_t opcode;
+		uint8_t flags;
+		uint16_t ioprio;
+		int32_t fd;
+		uint64_t off;
+		uint64_t addr;
+		uint32_t len;
+		uint32_t rw_flags;
+		uint64_t user_data;
+		uint64_t pad[3];
+	};
+	static_assert(sizeof(io_uring_sqe) == 64);
+
+	struct io_uring_cqe {
+		uint64_t user_data;
+		int32_t res;
+		uint32_t flags;
+	};
+
+	constexpr uint8_t IORING_OP_WRITE = 23;
+	constexpr unsigned int IORING_ENTER_GETEVENTS = 1;
+	constexpr off_t IORING_OFF_SQ_RING = 0;
+	constexpr off_t IORING_OFF_CQ_RING = 0x8000000;
+	constexpr off_t IORING_OFF_SQES = 0x10000000;
+
+	constexpr uint32_t ringEntries = 32;
+
+	// Raw kernel error codes; do_syscall() does not translate them to mlibc's values.
+	constexpr int LINUX_EAGAIN = 11;
+	constexpr int LINUX_EBUSY = 16;
+	constexpr int LINUX_EINTR = 4;
+
+	// Note that this sysdep is not thread-safe (like the rest of the Linux port).
+	struct {
+		bool initialized;
+		int error; // Set if the ring could not be created.
+		int fd;
+		uint32_t *sq_head, *sq_tail, *sq_array, sq_mask, sq_entries;
+		io_uring_sqe *sqes;
+		uint32_t *cq_head, *cq_tail, cq_mask;
+		io_uring_cqe *cqes;
+		uint32_t in_flight;
+		uint64_t last_ticket;
+
+		// Completions that were reaped while waiting for a different ticket.
+		struct {
+			uint64_t ticket;
+			int32_t result;
+		} reaped[ringEntries];
+		uint32_t num_reaped;
+	} ring;
+
+	int ring_enter(unsigned int to_submit, unsigned int min_complete, unsigned int flags,
+			int *submitted) {
+		auto ret = do_syscall(NR_io_uring_enter, ring.fd, to_submit, min_complete, flags, 0L, 0L);
+		if(int e = sc_error(ret); e)
+			return e;
+		*submitted = sc_int_result<int>(ret);
+		return 0;
+	}
+
+	int ring_init() {
+		if(ring.initialized)
+			return ring.error;
+		ring.initialized = true;
+
+		io_uring_params params{};
+		auto ret = do_syscall(NR_io_uring_setup, ringEntries, &params);
+		if(int e = sc_error(ret); e) {
+			ring.error = e;
+			return e;
+		}
+		ring.fd = sc_int_result<int>(ret);
+
+		// Since sys_vm_unmap() is not available, mappings are leaked on failure.
+		void *sq_ring, *cq_ring, *sqes;
+		size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		if(int e = sys_vm_map(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+				ring.fd, IORING_OFF_SQ_RING, &sq_ring); e) {
+			ring.error = e;
+			return e;
+		}
+		if(int e = sys_vm_map(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+				ring.fd, IORING_OFF_CQ_RING, &cq_ring); e) {
+			ring.error = e;
+			return e;
+		}
+		if(int e = sys_vm_map(nullptr, params.sq_entries * sizeof(io_uring_sqe),
+				PROT_READ | PROT_WRITE, MAP_SHARED, ring.fd, IORING_OFF_SQES, &sqes); e) {
+			ring.error = e;
+			return e;
+		}
+
+		auto sq_base = reinterpret_cast<char *>(sq_ring);
+		auto cq_base = reinterpret_cast<char *>(cq_ring);
+		ring.sq_head = reinterpret_cast<uint32_t *>(sq_base + params.sq_off.head);
+		ring.sq_tail = reinterpret_cast<uint32_t *>(sq_base + params.sq_off.tail);
+		ring.sq_array = reinterpret_cast<uint32_t *>(sq_base + params.sq_off.array);
+		ring.sq_mask = *reinterpret_cast<uint32_t *>(sq_base + params.sq_off.ring_mask);
+		ring.sq_entries = params.sq_entries;
+		ring.sqes = reinterpret_cast<io_uring_sqe *>(sqes);
+		ring.cq_head = reinterpret_cast<uint32_t *>(cq_base + params.cq_off.head);
+		ring.cq_tail = reinterpret_cast<uint32_t *>(cq_base + params.cq_off.tail);
+		ring.cq_mask = *reinterpret_cast<uint32_t *>(cq_base + params.cq_off.ring_mask);
+		ring.cqes = reinterpret_cast<io_uring_cqe *>(cq_base + params.cq_off.cqes);
+		return 0;
+	}
+}
+
+int sys_write_async(int fd, const void *buffer, size_t size, uint64_t *ticket) {
+	if(int e = ring_init(); e)
+		return e;
+	// Limit the number of writes such that the completion queue cannot overflow.
+	if(ring.in_flight == ringEntries || ring.in_flight == ring.sq_entries)
+		return EAGAIN;
+
+	auto tail = *ring.sq_tail;
+	auto index = tail & ring.sq_mask;
+	auto sqe = &ring.sqes[index];
+	*sqe = io_uring_sqe{};
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = fd;
+	sqe->off = static_cast<uint64_t>(-1); // Use (and update) the file position.
+	sqe->addr = reinterpret_cast<uintptr_t>(buffer);
+	sqe->len = size;
+	sqe->user_data = ++ring.last_ticket;
+	ring.sq_array[index] = index;
+	__atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	int submitted;
+	if(int e = ring_enter(1, 0, 0, &submitted); e || !submitted) {
+		// The kernel only consumes entries during io_uring_enter(), so we can take it back.
+		__atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+		return e ? e : EAGAIN;
+	}
+	ring.in_flight++;
+	*ticket = ring.last_ticket;
+	return 0;
+}
+
+int sys_write_async_wait(uint64_t ticket, ssize_t *bytes_written) {
+	__ensure(ring.initialized && !ring.error);
+
+	auto complete = [&] (int32_t result) -> int {
+		ring.in_flight--;
+		if(result < 0)
+			return -result;
+		*bytes_written = result;
+		return 0;
+	};
+
+	while(true) {
+		for(uint32_t i = 0; i < ring.num_reaped; i++) {
+			if(ring.reaped[i].ticket != ticket)
+				continue;
+			auto result = ring.reaped[i].result;
+			ring.reaped[i] = ring.reaped[--ring.num_reaped];
+			return complete(result);
+		}
+
+		// Reap all available completions.
+		bool found = false;
+		int32_t found_result;
+		auto head = *ring.cq_head;
+		auto tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+		for(; head != tail; head++) {
+			auto cqe = &ring.cqes[head & ring.cq_mask];
+			if(cqe->user_data == ticket) {
+				found = true;
+				found_result = cqe->res;
+			}else{
+				__ensure(ring.num_reaped < ringEntries);
+				ring.reaped[ring.num_reaped].ticket = cqe->user_data;
+				ring.reaped[ring.num_reaped].result = cqe->res;
+				ring.num_reaped++;
+			}
+		}
+		__atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+		if(found)
+			return complete(found_result);
+
+		// The write stays in flight (and keeps using the caller's buffer) even if we return,
+		// and its completion would never be collected. Thus, we have to keep waiting.
+		int submitted;
+		if(int e = ring_enter(0, 1, IORING_ENTER_GETEVENTS, &submitted); e
+				&& e != LINUX_EINTR && e != LINUX_EAGAIN && e != LINUX_EBUSY)
+			mlibc::panicLogger() << "mlibc: io_uring_enter() failed while waiting"
+					" for a write, error " << e << frg::endlog;
+	}
+}
+
 #endif // MLIBC_BUILDING_RTDL
 
 } // namespace mlibc
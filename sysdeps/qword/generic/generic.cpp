@@ -210,7 +210,9 @@ int sys_seek(int fd, off_t offset, int whence, off_t *new_offset) {
 
 int sys_vm_map(void *hint, size_t size, int prot, int flags,
 		int fd, off_t offset, void **window) {
-    __ensure(flags & MAP_ANONYMOUS);
+    // File mappings are not supported; mmap_file falls back to sys_read() on this error.
+    if(!(flags & MAP_ANONYMOUS))
+        return ENOSYS;
     void *res;
     size_t size_in_pages = (size + 4096 - 1) / 4096;
     asm volatile ("syscall" : "=a"(res)
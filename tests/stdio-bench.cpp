@@ -0,0 +1,508 @@
+// Throughput benchmark for the stdio implementation (file-io.cpp and stdio-stubs.cpp).
+//
+// Like string-kernels, this is a host program: the stdio sources are compiled as for
+// libc.a, but with an mlibc_ prefix (see stdio-under-test.h). The sysdeps that they
+// call are implemented below on top of the host's system calls; they count the reads,
+// writes and seeks that mlibc issues and translate errors (see stdio-errno.h).
+// Each case is also run against the host libc, for which the read and write counts
+// are taken from /proc/self/io.
+//
+// Usage: stdio-bench [--size=<bytes>] [case]
+// The size (16 MiB by default) is the amount of data that each case transfers.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stdio-errno.h"
+
+// The stdio functions under test. Their FILE type is opaque to this program.
+struct mlibc_file;
+
+extern "C" {
+	extern __thread int __mlibc_errno;
+
+	mlibc_file *mlibc_fopen(const char *, const char *);
+	int mlibc_fclose(mlibc_file *);
+	int mlibc_getc(mlibc_file *);
+	int mlibc_putc(int, mlibc_file *);
+	char *mlibc_fgets(char *, int, mlibc_file *);
+	size_t mlibc_fread(void *, size_t, size_t, mlibc_file *);
+	size_t mlibc_fwrite(const void *, size_t, size_t, mlibc_file *);
+	int mlibc_fseek(mlibc_file *, long, int);
+	int mlibc_fprintf(mlibc_file *, const char *, ...);
+	int mlibc_snprintf(char *, size_t, const char *, ...);
+
+	extern const int mlibc_errno_values[];
+}
+
+// The code under test keeps errno here.
+__thread int __mlibc_errno;
+
+namespace {
+
+struct io_counts {
+	unsigned long reads;
+	unsigned long writes;
+	unsigned long seeks;
+};
+
+io_counts sysdep_counts;
+
+#define STDIO_BENCH_VALUE(name) name,
+
+const int host_errno_values[] = {
+	STDIO_BENCH_ERRNOS(STDIO_BENCH_VALUE)
+};
+
+constexpr size_t num_errno_values = sizeof(host_errno_values) / sizeof(int);
+
+// Translates a host errno value to mlibc's value.
+int mlibc_error(int e) {
+	for(size_t i = 0; i < num_errno_values; i++)
+		if(host_errno_values[i] == e)
+			return mlibc_errno_values[i];
+	return mlibc_errno_values[0];
+}
+
+// Translates an mlibc errno value to the host's value.
+int host_error(int e) {
+	for(size_t i = 0; i < num_errno_values; i++)
+		if(mlibc_errno_values[i] == e)
+			return host_errno_values[i];
+	return host_errno_values[0];
+}
+
+} // anonymous namespace
+
+// The sysdeps of the code under test. Errors are returned as mlibc's errno values.
+namespace mlibc {
+	void sys_libc_log(const char *message) {
+		fprintf(stderr, "%s\n", message);
+	}
+
+	[[noreturn]] void sys_libc_panic() {
+		abort();
+	}
+
+	int sys_anon_allocate(size_t size, void **pointer) {
+		auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(p == MAP_FAILED)
+			return mlibc_error(errno);
+		*pointer = p;
+		return 0;
+	}
+
+	int sys_anon_free(void *pointer, size_t size) {
+		if(munmap(pointer, size))
+			return mlibc_error(errno);
+		return 0;
+	}
+
+	// The linux sysdeps pass the flags through to the kernel; so do we.
+	int sys_open(const char *path, int flags, int *fd) {
+		int result = open(path, flags, 0666);
+		if(result < 0)
+			return mlibc_error(errno);
+		*fd = result;
+		return 0;
+	}
+
+	int sys_read(int fd, void *buffer, size_t size, ssize_t *bytes_read) {
+		sysdep_counts.reads++;
+		auto result = read(fd, buffer, size);
+		if(result < 0)
+			return mlibc_error(errno);
+		*bytes_read = result;
+		return 0;
+	}
+
+	int sys_write(int fd, const void *buffer, size_t size, ssize_t *bytes_written) {
+		sysdep_counts.writes++;
+		auto result = write(fd, buffer, size);
+		if(result < 0)
+			return mlibc_error(errno);
+		*bytes_written = result;
+		return 0;
+	}
+
+	int sys_seek(int fd, off_t offset, int whence, off_t *new_offset) {
+		sysdep_counts.seeks++;
+		auto result = lseek(fd, offset, whence);
+		if(result < 0)
+			return mlibc_error(errno);
+		*new_offset = result;
+		return 0;
+	}
+
+	int sys_close(int fd) {
+		if(close(fd))
+			return mlibc_error(errno);
+		return 0;
+	}
+
+	int sys_isatty(int fd) {
+		if(!isatty(fd))
+			return mlibc_error(errno);
+		return 0;
+	}
+
+	int sys_vm_map(void *hint, size_t size, int prot, int flags, int fd, off_t offset,
+			void **window) {
+		auto p = mmap(hint, size, prot, flags, fd, offset);
+		if(p == MAP_FAILED)
+			return mlibc_error(errno);
+		*window = p;
+		return 0;
+	}
+
+	int sys_vm_unmap(void *pointer, size_t size) {
+		if(munmap(pointer, size))
+			return mlibc_error(errno);
+		return 0;
+	}
+}
+
+namespace {
+
+//---------------------------------------------------------------------------------------
+// The two implementations.
+//---------------------------------------------------------------------------------------
+
+struct mlibc_stdio {
+	using file = mlibc_file;
+	static constexpr const char *name = "mlibc";
+
+	static file *open(const char *path, const char *mode) { return mlibc_fopen(path, mode); }
+	static int close(file *f) { return mlibc_fclose(f); }
+	static int get(file *f) { return mlibc_getc(f); }
+	static int put(int c, file *f) { return mlibc_putc(c, f); }
+	static char *gets(char *s, int n, file *f) { return mlibc_fgets(s, n, f); }
+	static size_t read(void *p, size_t n, file *f) { return mlibc_fread(p, 1, n, f); }
+	static size_t write(const void *p, size_t n, file *f) { return mlibc_fwrite(p, 1, n, f); }
+	static int seek(file *f, long offset) { return mlibc_fseek(f, offset, SEEK_SET); }
+
+	template<typename... Args>
+	static int print(file *f, const char *format, Args... args) {
+		return mlibc_fprintf(f, format, args...);
+	}
+
+	template<typename... Args>
+	static int format(char *s, size_t n, const char *format, Args... args) {
+		return mlibc_snprintf(s, n, format, args...);
+	}
+
+	static constexpr bool counts_seeks = true;
+
+	static bool counts(io_counts *c) {
+		*c = sysdep_counts;
+		return true;
+	}
+
+	static int error() { return host_error(__mlibc_errno); }
+};
+
+struct host_stdio {
+	using file = FILE;
+	static constexpr const char *name = "host";
+
+	static file *open(const char *path, const char *mode) { return fopen(path, mode); }
+	static int close(file *f) { return fclose(f); }
+	static int get(file *f) { return getc(f); }
+	static int put(int c, file *f) { return putc(c, f); }
+	static char *gets(char *s, int n, file *f) { return fgets(s, n, f); }
+	static size_t read(void *p, size_t n, file *f) { return fread(p, 1, n, f); }
+	static size_t write(const void *p, size_t n, file *f) { return fwrite(p, 1, n, f); }
+	static int seek(file *f, long offset) { return fseek(f, offset, SEEK_SET); }
+
+	template<typename... Args>
+	static int print(file *f, const char *format, Args... args) {
+		return fprintf(f, format, args...);
+	}
+
+	template<typename... Args>
+	static int format(char *s, size_t n, const char *format, Args... args) {
+		return snprintf(s, n, format, args...);
+	}
+
+	// Seeks are not visible in /proc/self/io; we only report reads and writes.
+	static constexpr bool counts_seeks = false;
+
+	static bool counts(io_counts *c) {
+		// Our reads of /proc/self/io are counted as well; we subtract them.
+		static unsigned long own_reads;
+		static int fd = ::open("/proc/self/io", O_RDONLY);
+		if(fd < 0)
+			return false;
+		char buffer[512];
+		auto n = pread(fd, buffer, sizeof(buffer) - 1, 0);
+		if(n <= 0)
+			return false;
+		buffer[n] = 0;
+		auto syscr = strstr(buffer, "syscr:");
+		auto syscw = strstr(buffer, "syscw:");
+		if(!syscr || !syscw)
+			return false;
+		c->reads = strtoul(syscr + 6, nullptr, 10) - own_reads++;
+		c->writes = strtoul(syscw + 6, nullptr, 10);
+		c->seeks = 0;
+		return true;
+	}
+
+	static int error() { return errno; }
+};
+
+//---------------------------------------------------------------------------------------
+// Measurement.
+//---------------------------------------------------------------------------------------
+
+constexpr size_t max_block = 16 << 20;
+
+size_t total_size = 16 << 20;
+char path[] = "/tmp/mlibc-stdio-bench-XXXXXX";
+unsigned char *data;
+
+uint64_t now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+}
+
+// Creates the input of a case without going through stdio.
+void write_file(const void *buffer, size_t size) {
+	int fd = open(path, O_WRONLY | O_TRUNC);
+	if(fd < 0 || write(fd, buffer, size) != ssize_t(size) || close(fd)) {
+		perror("stdio-bench: failed to write the input file");
+		exit(2);
+	}
+}
+
+template<typename Stdio>
+typename Stdio::file *open_or_die(const char *mode) {
+	auto f = Stdio::open(path, mode);
+	if(!f) {
+		fprintf(stderr, "stdio-bench: %s fopen(\"%s\") failed: %s\n",
+				Stdio::name, mode, strerror(Stdio::error()));
+		exit(2);
+	}
+	return f;
+}
+
+// Measures one run of body(), which returns the number of bytes that it transferred.
+template<typename Stdio, typename F>
+void measure(const char *what, size_t operations, F body) {
+	// Our own output must not show up in the host's counts.
+	fflush(stdout);
+
+	io_counts before, after;
+	bool have_counts = Stdio::counts(&before);
+	auto start = now();
+	size_t bytes = body();
+	auto elapsed = now() - start;
+	have_counts = have_counts && Stdio::counts(&after);
+
+	printf("%-16s %-6s %10.1f %10.1f", what, Stdio::name,
+			bytes / 1.048576 / elapsed * 1000, double(elapsed) / operations);
+	if(!have_counts) {
+		printf(" %9s %9s %9s\n", "-", "-", "-");
+	}else if(!Stdio::counts_seeks) {
+		printf(" %9lu %9lu %9s\n", after.reads - before.reads,
+				after.writes - before.writes, "-");
+	}else{
+		printf(" %9lu %9lu %9lu\n", after.reads - before.reads,
+				after.writes - before.writes, after.seeks - before.seeks);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Cases.
+//---------------------------------------------------------------------------------------
+
+// Random offsets for the seek cases.
+size_t next_offset(uint64_t *state, size_t size) {
+	*state = *state * 6364136223846793005 + 1442695040888963407;
+	return (*state >> 20) % (total_size - size);
+}
+
+template<typename Stdio>
+void run_case(const char *name, size_t block) {
+	char what[32];
+	size_t num_lines = total_size / 64;
+	size_t num_seeks = total_size / 256;
+
+	if(!strcmp(name, "putc")) {
+		measure<Stdio>("putc", total_size, [] {
+			auto f = open_or_die<Stdio>("w");
+			for(size_t i = 0; i < total_size; i++)
+				Stdio::put(data[i], f);
+			Stdio::close(f);
+			return total_size;
+		});
+	}else if(!strcmp(name, "getc")) {
+		write_file(data, total_size);
+		measure<Stdio>("getc", total_size, [] {
+			auto f = open_or_die<Stdio>("r");
+			size_t n = 0;
+			while(Stdio::get(f) != EOF)
+				n++;
+			Stdio::close(f);
+			return n;
+		});
+	}else if(!strcmp(name, "fwrite")) {
+		size_t count = (total_size > block ? total_size : block) / block;
+		sprintf(what, "fwrite %zu", block);
+		measure<Stdio>(what, count, [&] {
+			auto f = open_or_die<Stdio>("w");
+			size_t n = 0;
+			for(size_t i = 0; i < count; i++)
+				n += Stdio::write(data, block, f);
+			Stdio::close(f);
+			return n;
+		});
+	}else if(!strcmp(name, "fread")) {
+		size_t count = (total_size > block ? total_size : block) / block;
+		write_file(data, count * block);
+		auto buffer = static_cast<unsigned char *>(malloc(block));
+		sprintf(what, "fread %zu", block);
+		measure<Stdio>(what, count, [&] {
+			auto f = open_or_die<Stdio>("r");
+			size_t n = 0;
+			for(size_t i = 0; i < count; i++)
+				n += Stdio::read(buffer, block, f);
+			Stdio::close(f);
+			return n;
+		});
+		free(buffer);
+	}else if(!strcmp(name, "fgets")) {
+		// Lines of 0 to 127 letters.
+		auto text = static_cast<char *>(malloc(total_size));
+		size_t size = 0;
+		while(size + 128 <= total_size) {
+			size_t length = data[size] & 127;
+			for(size_t k = 0; k < length; k++)
+				text[size + k] = 'a' + data[size + k] % 26;
+			text[size + length] = '\n';
+			size += length + 1;
+		}
+		write_file(text, size);
+		free(text);
+		measure<Stdio>("fgets", size / 64, [] {
+			char line[256];
+			auto f = open_or_die<Stdio>("r");
+			size_t n = 0;
+			while(Stdio::gets(line, sizeof(line), f))
+				n += strlen(line);
+			Stdio::close(f);
+			return n;
+		});
+	}else if(!strcmp(name, "fprintf")) {
+		measure<Stdio>("fprintf", num_lines, [&] {
+			auto f = open_or_die<Stdio>("w");
+			size_t n = 0;
+			for(size_t i = 0; i < num_lines; i++)
+				n += Stdio::print(f, "%d %s %x %08.3f %c %ld %5u|%-8s|\n",
+						int(i), "text", unsigned(i * 7), i * 0.25, 'a' + int(i % 26),
+						long(i) * long(i), unsigned(i % 1000), "left");
+			Stdio::close(f);
+			return n;
+		});
+	}else if(!strcmp(name, "snprintf")) {
+		measure<Stdio>("snprintf", num_lines, [&] {
+			char line[128];
+			size_t n = 0;
+			for(size_t i = 0; i < num_lines; i++)
+				n += Stdio::format(line, sizeof(line), "%d %s %x %08.3f %c %ld %5u|%-8s|\n",
+						int(i), "text", unsigned(i * 7), i * 0.25, 'a' + int(i % 26),
+						long(i) * long(i), unsigned(i % 1000), "left");
+			return n;
+		});
+	}else if(!strcmp(name, "fseek+fread")) {
+		write_file(data, total_size);
+		measure<Stdio>("fseek+fread", num_seeks, [&] {
+			char buffer[64];
+			auto f = open_or_die<Stdio>("r");
+			size_t n = 0;
+			uint64_t state = 0;
+			for(size_t i = 0; i < num_seeks; i++) {
+				Stdio::seek(f, next_offset(&state, sizeof(buffer)));
+				n += Stdio::read(buffer, sizeof(buffer), f);
+			}
+			Stdio::close(f);
+			return n;
+		});
+	}else if(!strcmp(name, "fseek+fwrite")) {
+		write_file(data, total_size);
+		measure<Stdio>("fseek+fwrite", num_seeks, [&] {
+			auto f = open_or_die<Stdio>("r+");
+			size_t n = 0;
+			uint64_t state = 0;
+			for(size_t i = 0; i < num_seeks; i++) {
+				Stdio::seek(f, next_offset(&state, 64));
+				n += Stdio::write(data + i % 4096, 64, f);
+			}
+			Stdio::close(f);
+			return n;
+		});
+	}
+}
+
+const char *cases[] = {"putc", "getc", "fwrite", "fread", "fgets", "fprintf", "snprintf",
+		"fseek+fread", "fseek+fwrite"};
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+	const char *filter = nullptr;
+	for(int i = 1; i < argc; i++) {
+		if(!strncmp(argv[i], "--size=", 7)) {
+			total_size = strtoull(argv[i] + 7, nullptr, 0);
+		}else{
+			filter = argv[i];
+		}
+	}
+	if(total_size < 4096) {
+		fprintf(stderr, "stdio-bench: the size must be at least 4096 bytes\n");
+		return 2;
+	}
+
+	int fd = mkstemp(path);
+	if(fd < 0) {
+		perror("stdio-bench: mkstemp() failed");
+		return 2;
+	}
+	close(fd);
+
+	size_t data_size = total_size > max_block ? total_size : max_block;
+	data = static_cast<unsigned char *>(malloc(data_size));
+	uint64_t state = 0x9E3779B97F4A7C15;
+	for(size_t i = 0; i < data_size; i++) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		data[i] = state;
+	}
+
+	printf("%-16s %-6s %10s %10s %9s %9s %9s\n", "case", "libc", "MiB/s", "ns/op",
+			"reads", "writes", "seeks");
+	for(auto name : cases) {
+		if(filter && strcmp(filter, name))
+			continue;
+		bool sweep = !strcmp(name, "fwrite") || !strcmp(name, "fread");
+		for(size_t block = 1; block <= (sweep ? max_block : 1); block *= 16) {
+			run_case<mlibc_stdio>(name, block);
+			run_case<host_stdio>(name, block);
+			fflush(stdout);
+		}
+	}
+
+	unlink(path);
+	return 0;
+}
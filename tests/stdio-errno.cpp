@@ -0,0 +1,11 @@
+// Exports mlibc's errno values to stdio-bench, which is compiled against the host libc.
+
+#include <errno.h>
+
+#include "stdio-errno.h"
+
+#define STDIO_BENCH_VALUE(name) name,
+
+extern "C" const int mlibc_errno_values[] = {
+	STDIO_BENCH_ERRNOS(STDIO_BENCH_VALUE)
+};
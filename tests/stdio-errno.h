@@ -0,0 +1,14 @@
+#ifndef MLIBC_TESTS_STDIO_ERRNO_H
+#define MLIBC_TESTS_STDIO_ERRNO_H
+
+// The errno values of mlibc differ from those of the host libc. stdio-bench translates
+// the errors of its sysdeps; for this purpose, this list is expanded against both the
+// host's <errno.h> (in stdio-bench.cpp) and mlibc's <errno.h> (in stdio-errno.cpp).
+// Errors that are not listed are reported as EIO, which therefore comes first.
+
+#define STDIO_BENCH_ERRNOS(X) \
+	X(EIO) X(EACCES) X(EAGAIN) X(EBADF) X(EEXIST) X(EFBIG) X(EINTR) X(EINVAL) \
+	X(EISDIR) X(EMFILE) X(ENAMETOOLONG) X(ENOENT) X(ENOMEM) X(ENOSPC) X(ENOSYS) \
+	X(ENOTDIR) X(ENOTTY) X(EPERM) X(ESPIPE)
+
+#endif // MLIBC_TESTS_STDIO_ERRNO_H
@@ -0,0 +1,106 @@
+#ifndef MLIBC_TESTS_STDIO_UNDER_TEST_H
+#define MLIBC_TESTS_STDIO_UNDER_TEST_H
+
+// This header is force-included into the libc sources that stdio-bench links against.
+// Like string-under-test.h, it gives the stdio.h functions an mlibc_ prefix.
+
+#include "string-under-test.h"
+
+#define __fpurge mlibc___fpurge
+#define __fstats mlibc___fstats
+#define __fstats_dump mlibc___fstats_dump
+#define asprintf mlibc_asprintf
+#define clearerr mlibc_clearerr
+#define clearerr_unlocked mlibc_clearerr_unlocked
+#define fclose mlibc_fclose
+#define fdopen mlibc_fdopen
+#define feof mlibc_feof
+#define feof_unlocked mlibc_feof_unlocked
+#define ferror mlibc_ferror
+#define ferror_unlocked mlibc_ferror_unlocked
+#define fflush mlibc_fflush
+#define fflush_unlocked mlibc_fflush_unlocked
+#define fgetc mlibc_fgetc
+#define fgetc_unlocked mlibc_fgetc_unlocked
+#define fgetpos mlibc_fgetpos
+#define fgets mlibc_fgets
+#define fgets_unlocked mlibc_fgets_unlocked
+#define fgetwc mlibc_fgetwc
+#define fgetws mlibc_fgetws
+#define fileno mlibc_fileno
+#define fileno_unlocked mlibc_fileno_unlocked
+#define flockfile mlibc_flockfile
+#define fopen mlibc_fopen
+#define fprintf mlibc_fprintf
+#define fputc mlibc_fputc
+#define fputc_unlocked mlibc_fputc_unlocked
+#define fputs mlibc_fputs
+#define fputs_unlocked mlibc_fputs_unlocked
+#define fputwc mlibc_fputwc
+#define fputws mlibc_fputws
+#define fread mlibc_fread
+#define fread_unlocked mlibc_fread_unlocked
+#define freopen mlibc_freopen
+#define fscanf mlibc_fscanf
+#define fseek mlibc_fseek
+#define fsetpos mlibc_fsetpos
+#define ftell mlibc_ftell
+#define ftrylockfile mlibc_ftrylockfile
+#define funlockfile mlibc_funlockfile
+#define fwide mlibc_fwide
+#define fwprintf mlibc_fwprintf
+#define fwrite mlibc_fwrite
+#define fwrite_unlocked mlibc_fwrite_unlocked
+#define fwscanf mlibc_fwscanf
+#define getc mlibc_getc
+#define getc_unlocked mlibc_getc_unlocked
+#define getchar mlibc_getchar
+#define getchar_unlocked mlibc_getchar_unlocked
+#define getwc mlibc_getwc
+#define getwchar mlibc_getwchar
+#define perror mlibc_perror
+#define printf mlibc_printf
+#define putc mlibc_putc
+#define putc_unlocked mlibc_putc_unlocked
+#define putchar mlibc_putchar
+#define putchar_unlocked mlibc_putchar_unlocked
+#define puts mlibc_puts
+#define putwc mlibc_putwc
+#define putwchar mlibc_putwchar
+#define remove mlibc_remove
+#define rename mlibc_rename
+#define renameat mlibc_renameat
+#define rewind mlibc_rewind
+#define scanf mlibc_scanf
+#define setbuf mlibc_setbuf
+#define setvbuf mlibc_setvbuf
+#define snprintf mlibc_snprintf
+#define sprintf mlibc_sprintf
+#define sscanf mlibc_sscanf
+#define stderr mlibc_stderr
+#define stdin mlibc_stdin
+#define stdout mlibc_stdout
+#define swprintf mlibc_swprintf
+#define swscanf mlibc_swscanf
+#define tmpfile mlibc_tmpfile
+#define tmpnam mlibc_tmpnam
+#define ungetc mlibc_ungetc
+#define ungetwc mlibc_ungetwc
+#define vasprintf mlibc_vasprintf
+#define vfprintf mlibc_vfprintf
+#define vfscanf mlibc_vfscanf
+#define vfwprintf mlibc_vfwprintf
+#define vfwscanf mlibc_vfwscanf
+#define vprintf mlibc_vprintf
+#define vscanf mlibc_vscanf
+#define vsnprintf mlibc_vsnprintf
+#define vsprintf mlibc_vsprintf
+#define vsscanf mlibc_vsscanf
+#define vswprintf mlibc_vswprintf
+#define vswscanf mlibc_vswscanf
+#define vwprintf mlibc_vwprintf
+#define vwscanf mlibc_vwscanf
+#define wprintf mlibc_wprintf
+#define wscanf mlibc_wscanf
+
+#endif // MLIBC_TESTS_STDIO_UNDER_TEST_H
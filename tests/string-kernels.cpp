@@ -0,0 +1,1217 @@
+// Conformance test and benchmark for the string.h, strings.h and wchar.h functions.
+//
+// This is a host program: the libc sources that implement these functions are compiled
+// as for libc.a, but with an mlibc_ prefix (see string-under-test.h), and linked next to
+// the host libc. Every function is compared against a naive reference implementation
+// on buffers that are surrounded by PROT_NONE guard pages. Each function is run at
+// all alignments 0-63 and all lengths 0-4096, both at an alignment and such that the
+// object ends directly in front of a guard page.
+//
+// Functions that are still stubs in mlibc (e.g. wcscpy() or strxfrm()) are not tested.
+//
+// With --bench, the program instead times mlibc and the host libc over a size sweep.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+
+extern "C" {
+	void *mlibc_memchr(const void *, int, size_t);
+	int mlibc_memcmp(const void *, const void *, size_t);
+	void *mlibc_memcpy(void *, const void *, size_t);
+	void *mlibc_memmem(const void *, size_t, const void *, size_t);
+	void *mlibc_memmove(void *, const void *, size_t);
+	void *mlibc_mempcpy(void *, const void *, size_t);
+	void *mlibc_memrchr(const void *, int, size_t);
+	void *mlibc_memset(void *, int, size_t);
+	void *mlibc_rawmemchr(const void *, int);
+	char *mlibc_stpcpy(char *, const char *);
+	char *mlibc_stpncpy(char *, const char *, size_t);
+	char *mlibc_strcasestr(const char *, const char *);
+	char *mlibc_strcat(char *, const char *);
+	char *mlibc_strchr(const char *, int);
+	char *mlibc_strchrnul(const char *, int);
+	int mlibc_strcmp(const char *, const char *);
+	int mlibc_strcoll(const char *, const char *);
+	char *mlibc_strcpy(char *, const char *);
+	size_t mlibc_strcspn(const char *, const char *);
+	char *mlibc_strdup(const char *);
+	size_t mlibc_strlcat(char *, const char *, size_t);
+	size_t mlibc_strlcpy(char *, const char *, size_t);
+	size_t mlibc_strlen(const char *);
+	char *mlibc_strncat(char *, const char *, size_t);
+	int mlibc_strncmp(const char *, const char *, size_t);
+	char *mlibc_strncpy(char *, const char *, size_t);
+	char *mlibc_strndup(const char *, size_t);
+	size_t mlibc_strnlen(const char *, size_t);
+	char *mlibc_strpbrk(const char *, const char *);
+	char *mlibc_strrchr(const char *, int);
+	char *mlibc_strsep(char **, const char *);
+	size_t mlibc_strspn(const char *, const char *);
+	char *mlibc_strstr(const char *, const char *);
+	char *mlibc_strtok(char *, const char *);
+	char *mlibc_strtok_r(char *, const char *, char **);
+
+	int mlibc_bcmp(const void *, const void *, size_t);
+	int mlibc_strcasecmp(const char *, const char *);
+	int mlibc_strncasecmp(const char *, const char *, size_t);
+
+	wchar_t *mlibc_wcschr(const wchar_t *, wchar_t);
+	int mlibc_wcscmp(const wchar_t *, const wchar_t *);
+	size_t mlibc_wcslen(const wchar_t *);
+	int mlibc_wcsncmp(const wchar_t *, const wchar_t *, size_t);
+	size_t mlibc_wcsnlen(const wchar_t *, size_t);
+	wchar_t *mlibc_wcsrchr(const wchar_t *, wchar_t);
+	wchar_t *mlibc_wmemchr(const wchar_t *, wchar_t, size_t);
+	wchar_t *mlibc_wmemcpy(wchar_t *, const wchar_t *, size_t);
+	wchar_t *mlibc_wmemmove(wchar_t *, const wchar_t *, size_t);
+	wchar_t *mlibc_wmemset(wchar_t *, wchar_t, size_t);
+}
+
+// The code under test logs and panics through these sysdeps.
+namespace mlibc {
+	void sys_libc_log(const char *message) {
+		fprintf(stderr, "%s\n", message);
+	}
+
+	[[noreturn]] void sys_libc_panic() {
+		abort();
+	}
+}
+
+namespace {
+
+//---------------------------------------------------------------------------------------
+// Guarded buffers.
+//---------------------------------------------------------------------------------------
+
+// Passed instead of an alignment to place an object directly in front of the guard page.
+constexpr int at_guard = -1;
+
+constexpr size_t max_length = 4096;
+constexpr size_t num_alignments = 64;
+constexpr size_t marker_size = 16;
+constexpr unsigned char marker = 0xA5;
+
+struct guarded_buffer {
+	guarded_buffer(size_t size) {
+		size_t page_size = sysconf(_SC_PAGESIZE);
+		span = (size + page_size - 1) & ~(page_size - 1);
+		auto p = mmap(nullptr, span + 2 * page_size, PROT_NONE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(p == MAP_FAILED) {
+			perror("string-kernels: mmap() failed");
+			exit(2);
+		}
+		base = static_cast<unsigned char *>(p) + page_size;
+		if(mprotect(base, span, PROT_READ | PROT_WRITE)) {
+			perror("string-kernels: mprotect() failed");
+			exit(2);
+		}
+	}
+
+	// Returns an object of the given size that either starts at the given offset
+	// from a page boundary or ends in front of the trailing guard page.
+	unsigned char *place(size_t size, int align) {
+		if(align == at_guard)
+			return base + span - size;
+		return base + align;
+	}
+
+	wchar_t *place_wide(size_t count, int align) {
+		auto p = place(count * sizeof(wchar_t),
+				align == at_guard ? at_guard : align * int(sizeof(wchar_t)));
+		return reinterpret_cast<wchar_t *>(p);
+	}
+
+	// Marks the bytes around an object so that stray writes can be detected.
+	void mark_surroundings(const void *object, size_t size) {
+		auto p = static_cast<const unsigned char *>(object);
+		for(auto q = p - marker_size; q < p; q++)
+			if(q >= base)
+				*const_cast<unsigned char *>(q) = marker;
+		for(auto q = p + size; q < p + size + marker_size; q++)
+			if(q < base + span)
+				*const_cast<unsigned char *>(q) = marker;
+	}
+
+	bool surroundings_intact(const void *object, size_t size) {
+		auto p = static_cast<const unsigned char *>(object);
+		for(auto q = p - marker_size; q < p; q++)
+			if(q >= base && *q != marker)
+				return false;
+		for(auto q = p + size; q < p + size + marker_size; q++)
+			if(q < base + span && *q != marker)
+				return false;
+		return true;
+	}
+
+	unsigned char *base;
+	size_t span;
+};
+
+// Large enough for the biggest wide objects (memmove() uses up to two lengths).
+guarded_buffer first{2 * (max_length + 64) * sizeof(wchar_t) + 4096};
+guarded_buffer second{2 * (max_length + 64) * sizeof(wchar_t) + 4096};
+
+// Scratch space for the expected results.
+unsigned char expected[4 * (max_length + 64) * sizeof(wchar_t)];
+
+//---------------------------------------------------------------------------------------
+// Random data.
+//---------------------------------------------------------------------------------------
+
+uint64_t random_state = 0x9E3779B97F4A7C15;
+
+uint64_t next_random() {
+	// xorshift64*.
+	random_state ^= random_state >> 12;
+	random_state ^= random_state << 25;
+	random_state ^= random_state >> 27;
+	return random_state * 0x2545F4914F6CDD1D;
+}
+
+size_t random_below(size_t n) {
+	return next_random() % n;
+}
+
+bool coin() {
+	return next_random() & 1;
+}
+
+unsigned char random_byte() {
+	return 1 + random_below(255);
+}
+
+// Biased towards the characters that vectorized code tends to get wrong.
+unsigned char pick_byte() {
+	static const unsigned char interesting[] = {1, 'a', 'A', 0x7F, 0x80, 0xC3, 0xFF};
+	if(coin())
+		return interesting[random_below(sizeof(interesting))];
+	return random_byte();
+}
+
+// Picks an int argument that converts to the given character, e.g. as a negative value.
+int char_argument(unsigned char c) {
+	switch(random_below(3)) {
+	case 0: return static_cast<signed char>(c);
+	case 1: return c | 0x100;
+	default: return c;
+	}
+}
+
+wchar_t pick_wide() {
+	static const wchar_t interesting[] = {1, L'a', 0x7F, 0x80, 0xFF, 0x100, 0xFFFF,
+			0x10000, 0x10FFFF, -1, INT32_MIN, INT32_MAX};
+	if(coin())
+		return interesting[random_below(sizeof(interesting) / sizeof(wchar_t))];
+	wchar_t c;
+	do {
+		c = static_cast<wchar_t>(next_random());
+	} while(!c);
+	return c;
+}
+
+void fill_bytes(unsigned char *p, size_t n) {
+	for(size_t i = 0; i < n; i++)
+		p[i] = next_random();
+}
+
+// Fills p[0, n) with non-zero bytes that differ from avoid.
+void fill_string(unsigned char *p, size_t n, unsigned char avoid = 0) {
+	for(size_t i = 0; i < n; i++) {
+		do {
+			p[i] = pick_byte();
+		} while(p[i] == avoid);
+	}
+}
+
+void fill_wide(wchar_t *p, size_t n, wchar_t avoid = 0) {
+	for(size_t i = 0; i < n; i++) {
+		do {
+			p[i] = pick_wide();
+		} while(p[i] == avoid);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Reference implementations.
+//---------------------------------------------------------------------------------------
+
+namespace ref {
+	bool equal(const void *a, const void *b, size_t n) {
+		auto x = static_cast<const unsigned char *>(a);
+		auto y = static_cast<const unsigned char *>(b);
+		for(size_t i = 0; i < n; i++)
+			if(x[i] != y[i])
+				return false;
+		return true;
+	}
+
+	int memcmp(const void *a, const void *b, size_t n) {
+		auto x = static_cast<const unsigned char *>(a);
+		auto y = static_cast<const unsigned char *>(b);
+		for(size_t i = 0; i < n; i++)
+			if(x[i] != y[i])
+				return x[i] < y[i] ? -1 : 1;
+		return 0;
+	}
+
+	size_t strnlen(const unsigned char *s, size_t limit) {
+		size_t n = 0;
+		while(n < limit && s[n])
+			n++;
+		return n;
+	}
+
+	int strncmp(const unsigned char *a, const unsigned char *b, size_t limit) {
+		for(size_t i = 0; i < limit; i++) {
+			if(a[i] != b[i])
+				return a[i] < b[i] ? -1 : 1;
+			if(!a[i])
+				return 0;
+		}
+		return 0;
+	}
+
+	unsigned char fold(unsigned char c) {
+		if(c >= 'A' && c <= 'Z')
+			return c - 'A' + 'a';
+		return c;
+	}
+
+	int strncasecmp(const unsigned char *a, const unsigned char *b, size_t limit) {
+		for(size_t i = 0; i < limit; i++) {
+			auto x = fold(a[i]);
+			auto y = fold(b[i]);
+			if(x != y)
+				return x < y ? -1 : 1;
+			if(!x)
+				return 0;
+		}
+		return 0;
+	}
+
+	bool in_set(unsigned char c, const unsigned char *set) {
+		for(size_t i = 0; set[i]; i++)
+			if(set[i] == c)
+				return true;
+		return false;
+	}
+
+	size_t span(const unsigned char *s, const unsigned char *set, bool accept) {
+		size_t n = 0;
+		while(s[n] && in_set(s[n], set) == accept)
+			n++;
+		return n;
+	}
+
+	// Returns the offset of the first match or SIZE_MAX.
+	size_t find(const unsigned char *haystack, size_t n,
+			const unsigned char *needle, size_t m, bool ignore_case) {
+		if(m > n)
+			return SIZE_MAX;
+		for(size_t i = 0; i + m <= n; i++) {
+			size_t k = 0;
+			while(k < m && (ignore_case ? fold(haystack[i + k]) == fold(needle[k])
+					: haystack[i + k] == needle[k]))
+				k++;
+			if(k == m)
+				return i;
+		}
+		return SIZE_MAX;
+	}
+
+	int wcsncmp(const wchar_t *a, const wchar_t *b, size_t limit) {
+		for(size_t i = 0; i < limit; i++) {
+			if(a[i] != b[i])
+				return a[i] < b[i] ? -1 : 1;
+			if(!a[i])
+				return 0;
+		}
+		return 0;
+	}
+} // namespace ref
+
+//---------------------------------------------------------------------------------------
+// Test driver.
+//---------------------------------------------------------------------------------------
+
+struct test_case {
+	int a; // Alignment of the object in the first buffer (or at_guard).
+	int b; // Alignment of the object in the second buffer (or at_guard).
+	size_t n; // Length of the objects, in characters.
+};
+
+const char *current_function;
+unsigned long num_failures;
+
+void describe_alignment(char *buffer, int align) {
+	if(align == at_guard) {
+		sprintf(buffer, "guard");
+	}else{
+		sprintf(buffer, "%d", align);
+	}
+}
+
+void report(const test_case &c, int line, const char *condition) {
+	if(num_failures++ >= 25)
+		return;
+	char a[16], b[16];
+	describe_alignment(a, c.a);
+	describe_alignment(b, c.b);
+	fprintf(stderr, "string-kernels: %s() failed for alignments %s/%s and length %zu"
+			" (line %d: %s)\n", current_function, a, b, c.n, line, condition);
+}
+
+#define CHECK(condition) do { if(!(condition)) report(c, __LINE__, #condition); } while(0)
+
+int sign(int x) {
+	return (x > 0) - (x < 0);
+}
+
+// Calls check() on every combination of placements.
+template<typename F>
+void sweep(F check) {
+	// All lengths, with the alignments cycling through all values.
+	for(size_t n = 0; n <= max_length; n++) {
+		int a = n % num_alignments;
+		int b = (n * 29 + 7) % num_alignments;
+		check(test_case{a, b, n});
+		check(test_case{at_guard, b, n});
+		check(test_case{a, at_guard, n});
+		check(test_case{at_guard, at_guard, n});
+	}
+
+	// All pairs of alignments for short lengths, where the kernels take their slow paths.
+	for(size_t n = 0; n <= 96; n++) {
+		for(int a = 0; a < int(num_alignments); a++) {
+			for(int b = 0; b < int(num_alignments); b++)
+				check(test_case{a, b, n});
+			check(test_case{a, at_guard, n});
+			check(test_case{at_guard, a, n});
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Memory functions.
+//---------------------------------------------------------------------------------------
+
+void check_memcpy(const test_case &c) {
+	auto src = second.place(c.n, c.b);
+	auto dest = first.place(c.n, c.a);
+	fill_bytes(src, c.n);
+	fill_bytes(dest, c.n);
+	first.mark_surroundings(dest, c.n);
+	if(coin()) {
+		CHECK(mlibc_memcpy(dest, src, c.n) == dest);
+	}else{
+		CHECK(mlibc_mempcpy(dest, src, c.n) == dest + c.n);
+	}
+	CHECK(ref::equal(dest, src, c.n));
+	CHECK(first.surroundings_intact(dest, c.n));
+}
+
+void check_memmove(const test_case &c) {
+	// Both objects are in the same block; they overlap unless the shift exceeds n.
+	size_t shift = random_below(c.n + 2);
+	auto block = first.place(c.n + shift, c.a);
+	auto src = block;
+	auto dest = block + shift;
+	if(coin()) {
+		src = block + shift;
+		dest = block;
+	}
+	fill_bytes(block, c.n + shift);
+	memcpy(expected, src, c.n);
+	first.mark_surroundings(block, c.n + shift);
+	CHECK(mlibc_memmove(dest, src, c.n) == dest);
+	CHECK(ref::equal(dest, expected, c.n));
+	CHECK(first.surroundings_intact(block, c.n + shift));
+}
+
+void check_memset(const test_case &c) {
+	auto dest = first.place(c.n, c.a);
+	unsigned char value = coin() ? 0 : pick_byte();
+	fill_bytes(dest, c.n);
+	first.mark_surroundings(dest, c.n);
+	CHECK(mlibc_memset(dest, char_argument(value), c.n) == dest);
+	for(size_t i = 0; i < c.n; i++) {
+		if(dest[i] != value) {
+			CHECK(dest[i] == value);
+			break;
+		}
+	}
+	CHECK(first.surroundings_intact(dest, c.n));
+}
+
+void check_memcmp(const test_case &c) {
+	auto x = first.place(c.n, c.a);
+	auto y = second.place(c.n, c.b);
+	fill_bytes(x, c.n);
+	memcpy(y, x, c.n);
+	if(c.n && coin()) {
+		size_t k = random_below(c.n);
+		y[k] = x[k] ^ random_byte();
+	}
+	// Differences past the end must be ignored.
+	if(c.a != at_guard && c.b != at_guard) {
+		x[c.n] = 1;
+		y[c.n] = 2;
+	}
+	int result = ref::memcmp(x, y, c.n);
+	CHECK(sign(mlibc_memcmp(x, y, c.n)) == result);
+	CHECK(!mlibc_bcmp(x, y, c.n) == !result);
+}
+
+void check_memchr(const test_case &c) {
+	auto s = first.place(c.n, c.a);
+	auto target = pick_byte();
+	fill_string(s, c.n, target);
+	size_t k = random_below(c.n + 1);
+	if(k < c.n) {
+		s[k] = target;
+		// A later occurrence must not be returned.
+		if(k + 1 < c.n && coin())
+			s[k + 1 + random_below(c.n - k - 1)] = target;
+	}
+	// Occurrences outside of the object must not be found.
+	if(c.a != at_guard)
+		s[c.n] = target;
+	if(s > first.base)
+		s[-1] = target;
+	auto found = static_cast<unsigned char *>(mlibc_memchr(s, char_argument(target), c.n));
+	CHECK(found == (k < c.n ? s + k : nullptr));
+	if(k < c.n) {
+		found = static_cast<unsigned char *>(mlibc_rawmemchr(s, char_argument(target)));
+		CHECK(found == s + k);
+	}
+}
+
+void check_memrchr(const test_case &c) {
+	auto s = first.place(c.n, c.a);
+	auto target = pick_byte();
+	fill_string(s, c.n, target);
+	size_t k = random_below(c.n + 1);
+	if(k < c.n) {
+		s[k] = target;
+		// An earlier occurrence must not be returned.
+		if(k && coin())
+			s[random_below(k)] = target;
+	}
+	if(c.a != at_guard)
+		s[c.n] = target;
+	if(s > first.base)
+		s[-1] = target;
+	auto found = static_cast<unsigned char *>(mlibc_memrchr(s, char_argument(target), c.n));
+	CHECK(found == (k < c.n ? s + k : nullptr));
+}
+
+void check_memmem(const test_case &c) {
+	// Draw from a small alphabet so that partial matches are common.
+	auto haystack = first.place(c.n, c.a);
+	for(size_t i = 0; i < c.n; i++)
+		haystack[i] = coin() ? 'a' : 'b';
+	size_t m = coin() ? random_below(c.n + 2) : random_below(c.n < 16 ? c.n + 2 : 16);
+	auto needle = second.place(m, c.b);
+	if(m <= c.n && coin()) {
+		memcpy(needle, haystack + random_below(c.n - m + 1), m);
+	}else{
+		for(size_t i = 0; i < m; i++)
+			needle[i] = coin() ? 'a' : 'b';
+	}
+	size_t k = ref::find(haystack, c.n, needle, m, false);
+	auto found = static_cast<unsigned char *>(mlibc_memmem(haystack, c.n, needle, m));
+	CHECK(found == (k != SIZE_MAX ? haystack + k : nullptr));
+}
+
+//---------------------------------------------------------------------------------------
+// String functions.
+//---------------------------------------------------------------------------------------
+
+// Returns a string of length n that ends in front of the guard page when requested.
+unsigned char *place_string(guarded_buffer &buffer, size_t n, int align,
+		unsigned char avoid = 0) {
+	auto s = buffer.place(n + 1, align);
+	fill_string(s, n, avoid);
+	s[n] = 0;
+	return s;
+}
+
+void check_strlen(const test_case &c) {
+	auto s = place_string(first, c.n, c.a);
+	CHECK(mlibc_strlen(reinterpret_cast<char *>(s)) == c.n);
+
+	size_t limit = random_below(c.n + 16);
+	CHECK(mlibc_strnlen(reinterpret_cast<char *>(s), limit) == (limit < c.n ? limit : c.n));
+
+	// strnlen() must not read past the limit if there is no null terminator.
+	auto t = second.place(c.n, c.b);
+	fill_string(t, c.n);
+	CHECK(mlibc_strnlen(reinterpret_cast<char *>(t), c.n) == c.n);
+}
+
+void check_strchr(const test_case &c) {
+	auto target = coin() ? 0 : pick_byte();
+	auto s = place_string(first, c.n, c.a, target);
+	size_t k = target ? random_below(c.n + 1) : c.n;
+	if(k < c.n) {
+		s[k] = target;
+		if(k + 1 < c.n && coin())
+			s[k + 1 + random_below(c.n - k - 1)] = target;
+	}
+	if(c.a != at_guard && target)
+		s[c.n + 1] = target;
+
+	auto str = reinterpret_cast<char *>(s);
+	auto found = mlibc_strchr(str, char_argument(target));
+	CHECK(found == (k < c.n || !target ? str + k : nullptr));
+	found = mlibc_strchrnul(str, char_argument(target));
+	CHECK(found == str + k);
+}
+
+void check_strrchr(const test_case &c) {
+	auto target = coin() ? 0 : pick_byte();
+	auto s = place_string(first, c.n, c.a, target);
+	size_t k = target ? random_below(c.n + 1) : c.n;
+	if(k < c.n) {
+		s[k] = target;
+		if(k && coin())
+			s[random_below(k)] = target;
+	}
+	if(c.a != at_guard && target)
+		s[c.n + 1] = target;
+
+	auto str = reinterpret_cast<char *>(s);
+	auto found = mlibc_strrchr(str, char_argument(target));
+	CHECK(found == (k < c.n || !target ? str + k : nullptr));
+}
+
+void check_strcmp(const test_case &c) {
+	auto x = place_string(first, c.n, c.a);
+	auto y = second.place(c.n + 1, c.b);
+	memcpy(y, x, c.n + 1);
+	if(c.n) {
+		size_t k = random_below(c.n);
+		switch(random_below(3)) {
+		case 0: // Strings differ.
+			do {
+				y[k] = pick_byte();
+			} while(y[k] == x[k]);
+			break;
+		case 1: // y is shorter.
+			y[k] = 0;
+			break;
+		}
+	}
+	auto a = reinterpret_cast<char *>(x);
+	auto b = reinterpret_cast<char *>(y);
+	CHECK(sign(mlibc_strcmp(a, b)) == ref::strncmp(x, y, SIZE_MAX));
+	CHECK(sign(mlibc_strcmp(b, a)) == ref::strncmp(y, x, SIZE_MAX));
+	CHECK(sign(mlibc_strcoll(a, b)) == ref::strncmp(x, y, SIZE_MAX));
+	size_t limit = coin() ? random_below(c.n + 8) : SIZE_MAX;
+	CHECK(sign(mlibc_strncmp(a, b, limit)) == ref::strncmp(x, y, limit));
+
+	// strncmp() must not read past the limit if there is no null terminator.
+	x = first.place(c.n, c.a);
+	y = second.place(c.n, c.b);
+	fill_string(x, c.n);
+	memcpy(y, x, c.n);
+	a = reinterpret_cast<char *>(x);
+	b = reinterpret_cast<char *>(y);
+	CHECK(!mlibc_strncmp(a, b, c.n));
+}
+
+void check_strcasecmp(const test_case &c) {
+	auto x = first.place(c.n + 1, c.a);
+	auto y = second.place(c.n + 1, c.b);
+	for(size_t i = 0; i < c.n; i++) {
+		x[i] = coin() ? 'a' + random_below(26) : pick_byte();
+		y[i] = x[i];
+		if(ref::fold(x[i]) >= 'a' && ref::fold(x[i]) <= 'z' && coin())
+			y[i] ^= 0x20;
+	}
+	x[c.n] = 0;
+	y[c.n] = 0;
+	if(c.n && coin()) {
+		size_t k = random_below(c.n);
+		if(coin()) {
+			y[k] = 0;
+		}else{
+			do {
+				y[k] = pick_byte();
+			} while(ref::fold(y[k]) == ref::fold(x[k]));
+		}
+	}
+	auto a = reinterpret_cast<char *>(x);
+	auto b = reinterpret_cast<char *>(y);
+	CHECK(sign(mlibc_strcasecmp(a, b)) == ref::strncasecmp(x, y, SIZE_MAX));
+	size_t limit = coin() ? random_below(c.n + 8) : SIZE_MAX;
+	CHECK(sign(mlibc_strncasecmp(a, b, limit)) == ref::strncasecmp(x, y, limit));
+}
+
+void check_strcpy(const test_case &c) {
+	auto src = place_string(second, c.n, c.b);
+	auto dest = first.place(c.n + 1, c.a);
+	fill_bytes(dest, c.n + 1);
+	first.mark_surroundings(dest, c.n + 1);
+	auto d = reinterpret_cast<char *>(dest);
+	auto s = reinterpret_cast<char *>(src);
+	if(coin()) {
+		CHECK(mlibc_strcpy(d, s) == d);
+	}else{
+		CHECK(mlibc_stpcpy(d, s) == d + c.n);
+	}
+	CHECK(ref::equal(dest, src, c.n + 1));
+	CHECK(first.surroundings_intact(dest, c.n + 1));
+}
+
+void check_strncpy(const test_case &c) {
+	size_t limit = random_below(c.n + 17);
+	// If the limit is reached before the terminator, the source may be unterminated.
+	unsigned char *src;
+	if(limit <= c.n && coin()) {
+		src = second.place(limit, c.b);
+		fill_string(src, limit);
+	}else{
+		src = place_string(second, c.n, c.b);
+	}
+	size_t length = ref::strnlen(src, limit);
+	auto dest = first.place(limit, c.a);
+	fill_bytes(dest, limit);
+	first.mark_surroundings(dest, limit);
+	auto d = reinterpret_cast<char *>(dest);
+	auto s = reinterpret_cast<char *>(src);
+	if(coin()) {
+		CHECK(mlibc_strncpy(d, s, limit) == d);
+	}else{
+		CHECK(mlibc_stpncpy(d, s, limit) == d + length);
+	}
+	CHECK(ref::equal(dest, src, length));
+	for(size_t i = length; i < limit; i++) {
+		if(dest[i]) {
+			CHECK(!dest[i]);
+			break;
+		}
+	}
+	CHECK(first.surroundings_intact(dest, limit));
+}
+
+void check_strlcpy(const test_case &c) {
+	size_t size = random_below(c.n + 17);
+	auto src = place_string(second, c.n, c.b);
+	auto dest = first.place(size, c.a);
+	fill_bytes(dest, size);
+	first.mark_surroundings(dest, size);
+	CHECK(mlibc_strlcpy(reinterpret_cast<char *>(dest),
+			reinterpret_cast<char *>(src), size) == c.n);
+	if(size) {
+		size_t copied = c.n < size - 1 ? c.n : size - 1;
+		CHECK(ref::equal(dest, src, copied));
+		CHECK(!dest[copied]);
+	}
+	CHECK(first.surroundings_intact(dest, size));
+}
+
+void check_strcat(const test_case &c) {
+	size_t prefix = random_below(17);
+	size_t limit = coin() ? random_below(c.n + 17) : SIZE_MAX;
+	unsigned char *src;
+	if(limit <= c.n && coin()) {
+		src = second.place(limit, c.b);
+		fill_string(src, limit);
+	}else{
+		src = place_string(second, c.n, c.b);
+	}
+	size_t length = ref::strnlen(src, limit);
+	auto dest = first.place(prefix + length + 1, c.a);
+	fill_string(dest, prefix + length + 1);
+	dest[prefix] = 0;
+	memcpy(expected, dest, prefix);
+	first.mark_surroundings(dest, prefix + length + 1);
+	auto d = reinterpret_cast<char *>(dest);
+	auto s = reinterpret_cast<char *>(src);
+	if(limit == SIZE_MAX && coin()) {
+		CHECK(mlibc_strcat(d, s) == d);
+	}else{
+		CHECK(mlibc_strncat(d, s, limit) == d);
+	}
+	CHECK(ref::equal(dest, expected, prefix));
+	CHECK(ref::equal(dest + prefix, src, length));
+	CHECK(!dest[prefix + length]);
+	CHECK(first.surroundings_intact(dest, prefix + length + 1));
+}
+
+void check_strlcat(const test_case &c) {
+	size_t prefix = random_below(17);
+	size_t size = random_below(prefix + c.n + 17);
+	auto src = place_string(second, c.n, c.b);
+	// If size <= prefix, dest is not terminated within size and must not be changed.
+	size_t object = size > prefix + 1 ? size : prefix + 1;
+	auto dest = first.place(object, c.a);
+	fill_string(dest, object);
+	dest[prefix] = 0;
+	memcpy(expected, dest, object);
+	first.mark_surroundings(dest, object);
+	size_t result = mlibc_strlcat(reinterpret_cast<char *>(dest),
+			reinterpret_cast<char *>(src), size);
+	if(size <= prefix) {
+		CHECK(result == size + c.n);
+		CHECK(ref::equal(dest, expected, object));
+	}else{
+		CHECK(result == prefix + c.n);
+		size_t copied = c.n < size - prefix - 1 ? c.n : size - prefix - 1;
+		CHECK(ref::equal(dest, expected, prefix));
+		CHECK(ref::equal(dest + prefix, src, copied));
+		CHECK(!dest[prefix + copied]);
+		CHECK(ref::equal(dest + prefix + copied + 1, expected + prefix + copied + 1,
+				object - prefix - copied - 1));
+	}
+	CHECK(first.surroundings_intact(dest, object));
+}
+
+void check_strspn(const test_case &c) {
+	size_t set_size = random_below(9);
+	auto set = second.place(set_size + 1, c.b);
+	for(size_t i = 0; i < set_size; i++)
+		set[i] = pick_byte();
+	set[set_size] = 0;
+
+	// Build a run of (non-)members of the set, followed by random characters.
+	bool accept = coin();
+	auto s = first.place(c.n + 1, c.a);
+	size_t run = random_below(c.n + 1);
+	for(size_t i = 0; i < c.n; i++) {
+		if(i < run && accept && set_size) {
+			s[i] = set[random_below(set_size)];
+		}else if(i < run) {
+			do {
+				s[i] = pick_byte();
+			} while(ref::in_set(s[i], set));
+		}else{
+			s[i] = pick_byte();
+		}
+	}
+	s[c.n] = 0;
+
+	auto str = reinterpret_cast<char *>(s);
+	auto chrs = reinterpret_cast<char *>(set);
+	CHECK(mlibc_strspn(str, chrs) == ref::span(s, set, true));
+	size_t k = ref::span(s, set, false);
+	CHECK(mlibc_strcspn(str, chrs) == k);
+	CHECK(mlibc_strpbrk(str, chrs) == (s[k] ? str + k : nullptr));
+}
+
+void check_strstr(const test_case &c) {
+	bool ignore_case = coin();
+	auto haystack = first.place(c.n + 1, c.a);
+	for(size_t i = 0; i < c.n; i++)
+		haystack[i] = "abAB"[random_below(ignore_case ? 4 : 2)];
+	haystack[c.n] = 0;
+	size_t m = coin() ? random_below(c.n + 2) : random_below(c.n < 16 ? c.n + 2 : 16);
+	auto needle = second.place(m + 1, c.b);
+	if(m <= c.n && coin()) {
+		memcpy(needle, haystack + random_below(c.n - m + 1), m);
+		if(ignore_case)
+			for(size_t i = 0; i < m; i++)
+				if(coin())
+					needle[i] ^= 0x20;
+	}else{
+		for(size_t i = 0; i < m; i++)
+			needle[i] = "abAB"[random_below(ignore_case ? 4 : 2)];
+	}
+	needle[m] = 0;
+
+	size_t k = ref::find(haystack, c.n, needle, m, ignore_case);
+	auto h = reinterpret_cast<char *>(haystack);
+	auto p = reinterpret_cast<char *>(needle);
+	auto found = ignore_case ? mlibc_strcasestr(h, p) : mlibc_strstr(h, p);
+	CHECK(found == (k != SIZE_MAX ? h + k : nullptr));
+}
+
+// Tokenizes s, either by strtok(), strtok_r() or strsep(), and compares the tokens
+// and the final contents of s against a naive tokenizer.
+void check_strtok(const test_case &c) {
+	int variant = random_below(3);
+	auto delimiters = second.place(3, c.b);
+	memcpy(delimiters, ",;", 3);
+	auto s = first.place(c.n + 1, c.a);
+	for(size_t i = 0; i < c.n; i++)
+		s[i] = "ab,;"[random_below(4)];
+	s[c.n] = 0;
+	memcpy(expected, s, c.n + 1);
+
+	auto str = reinterpret_cast<char *>(s);
+	auto del = reinterpret_cast<char *>(delimiters);
+	char *saved;
+	char *rest = str;
+	size_t i = 0;
+	bool first_call = true;
+	for(;;) {
+		// Expected token.
+		if(variant != 2)
+			while(i < c.n && ref::in_set(expected[i], delimiters))
+				i++;
+		bool done = variant == 2 ? i > c.n : i >= c.n;
+		size_t end = i;
+		while(end < c.n && !ref::in_set(expected[end], delimiters))
+			end++;
+
+		char *token;
+		switch(variant) {
+		case 0: token = mlibc_strtok(first_call ? str : nullptr, del); break;
+		case 1: token = mlibc_strtok_r(first_call ? str : nullptr, del, &saved); break;
+		default: token = mlibc_strsep(&rest, del); break;
+		}
+		first_call = false;
+		if(done) {
+			CHECK(!token);
+			break;
+		}
+		CHECK(token == str + i);
+		if(token != str + i)
+			break;
+		if(end < c.n)
+			expected[end] = 0;
+		i = end + 1;
+	}
+	CHECK(ref::equal(s, expected, c.n + 1));
+}
+
+void check_strdup(const test_case &c) {
+	auto src = place_string(first, c.n, c.a);
+	auto copy = mlibc_strdup(reinterpret_cast<char *>(src));
+	CHECK(copy && ref::equal(copy, src, c.n + 1));
+	free(copy);
+
+	size_t limit = random_below(c.n + 8);
+	if(limit <= c.n && coin()) {
+		src = second.place(limit, c.b);
+		fill_string(src, limit);
+	}
+	size_t length = ref::strnlen(src, limit);
+	copy = mlibc_strndup(reinterpret_cast<char *>(src), limit);
+	CHECK(copy && ref::equal(copy, src, length) && !copy[length]);
+	free(copy);
+}
+
+//---------------------------------------------------------------------------------------
+// Wide string functions.
+//---------------------------------------------------------------------------------------
+
+wchar_t *place_wide_string(guarded_buffer &buffer, size_t n, int align, wchar_t avoid = 0) {
+	auto s = buffer.place_wide(n + 1, align);
+	fill_wide(s, n, avoid);
+	s[n] = 0;
+	return s;
+}
+
+void check_wcslen(const test_case &c) {
+	auto s = place_wide_string(first, c.n, c.a);
+	CHECK(mlibc_wcslen(s) == c.n);
+	size_t limit = random_below(c.n + 16);
+	CHECK(mlibc_wcsnlen(s, limit) == (limit < c.n ? limit : c.n));
+
+	auto t = second.place_wide(c.n, c.b);
+	fill_wide(t, c.n);
+	CHECK(mlibc_wcsnlen(t, c.n) == c.n);
+}
+
+void check_wcschr(const test_case &c) {
+	wchar_t target = coin() ? 0 : pick_wide();
+	auto s = place_wide_string(first, c.n, c.a, target);
+	size_t k = target ? random_below(c.n + 1) : c.n;
+	size_t last = k;
+	if(k < c.n && coin()) {
+		s[k] = target;
+		if(k + 1 < c.n) {
+			last = k + 1 + random_below(c.n - k - 1);
+			s[last] = target;
+		}
+	}else if(k < c.n) {
+		s[k] = target;
+	}
+	if(c.a != at_guard && target)
+		s[c.n + 1] = target;
+	CHECK(mlibc_wcschr(s, target) == (k < c.n || !target ? s + k : nullptr));
+	CHECK(mlibc_wcsrchr(s, target) == (k < c.n || !target ? s + last : nullptr));
+}
+
+void check_wmemchr(const test_case &c) {
+	wchar_t target = pick_wide();
+	auto s = first.place_wide(c.n, c.a);
+	fill_wide(s, c.n, target);
+	size_t k = random_below(c.n + 1);
+	if(k < c.n)
+		s[k] = target;
+	if(c.a != at_guard)
+		s[c.n] = target;
+	CHECK(mlibc_wmemchr(s, target, c.n) == (k < c.n ? s + k : nullptr));
+}
+
+void check_wcscmp(const test_case &c) {
+	auto x = place_wide_string(first, c.n, c.a);
+	auto y = second.place_wide(c.n + 1, c.b);
+	memcpy(y, x, (c.n + 1) * sizeof(wchar_t));
+	if(c.n) {
+		size_t k = random_below(c.n);
+		switch(random_below(3)) {
+		case 0:
+			do {
+				y[k] = pick_wide();
+			} while(y[k] == x[k]);
+			break;
+		case 1:
+			y[k] = 0;
+			break;
+		}
+	}
+	CHECK(sign(mlibc_wcscmp(x, y)) == ref::wcsncmp(x, y, SIZE_MAX));
+	CHECK(sign(mlibc_wcscmp(y, x)) == ref::wcsncmp(y, x, SIZE_MAX));
+	size_t limit = coin() ? random_below(c.n + 8) : SIZE_MAX;
+	CHECK(sign(mlibc_wcsncmp(x, y, limit)) == ref::wcsncmp(x, y, limit));
+
+	x = first.place_wide(c.n, c.a);
+	y = second.place_wide(c.n, c.b);
+	fill_wide(x, c.n);
+	memcpy(y, x, c.n * sizeof(wchar_t));
+	CHECK(!mlibc_wcsncmp(x, y, c.n));
+}
+
+void check_wmemset(const test_case &c) {
+	wchar_t value = coin() ? 0 : pick_wide();
+	auto dest = first.place_wide(c.n, c.a);
+	fill_wide(dest, c.n);
+	first.mark_surroundings(dest, c.n * sizeof(wchar_t));
+	CHECK(mlibc_wmemset(dest, value, c.n) == dest);
+	for(size_t i = 0; i < c.n; i++) {
+		if(dest[i] != value) {
+			CHECK(dest[i] == value);
+			break;
+		}
+	}
+	CHECK(first.surroundings_intact(dest, c.n * sizeof(wchar_t)));
+}
+
+void check_wmemcpy(const test_case &c) {
+	size_t size = c.n * sizeof(wchar_t);
+	auto src = second.place_wide(c.n, c.b);
+	auto dest = first.place_wide(c.n, c.a);
+	fill_wide(src, c.n);
+	fill_wide(dest, c.n);
+	first.mark_surroundings(dest, size);
+	CHECK(mlibc_wmemcpy(dest, src, c.n) == dest);
+	CHECK(ref::equal(dest, src, size));
+	CHECK(first.surroundings_intact(dest, size));
+
+	size_t shift = random_below(c.n + 2);
+	auto block = first.place_wide(c.n + shift, c.a);
+	auto from = block;
+	auto to = block + shift;
+	if(coin()) {
+		from = block + shift;
+		to = block;
+	}
+	fill_wide(block, c.n + shift);
+	memcpy(expected, from, size);
+	first.mark_surroundings(block, (c.n + shift) * sizeof(wchar_t));
+	CHECK(mlibc_wmemmove(to, from, c.n) == to);
+	CHECK(ref::equal(to, expected, size));
+	CHECK(first.surroundings_intact(block, (c.n + shift) * sizeof(wchar_t)));
+}
+
+struct {
+	const char *name;
+	void (*check)(const test_case &);
+} tests[] = {
+	{"memcpy", check_memcpy},
+	{"memmove", check_memmove},
+	{"memset", check_memset},
+	{"memcmp", check_memcmp},
+	{"memchr", check_memchr},
+	{"memrchr", check_memrchr},
+	{"memmem", check_memmem},
+	{"strlen", check_strlen},
+	{"strchr", check_strchr},
+	{"strrchr", check_strrchr},
+	{"strcmp", check_strcmp},
+	{"strcasecmp", check_strcasecmp},
+	{"strcpy", check_strcpy},
+	{"strncpy", check_strncpy},
+	{"strlcpy", check_strlcpy},
+	{"strcat", check_strcat},
+	{"strlcat", check_strlcat},
+	{"strspn", check_strspn},
+	{"strstr", check_strstr},
+	{"strtok", check_strtok},
+	{"strdup", check_strdup},
+	{"wcslen", check_wcslen},
+	{"wcschr", check_wcschr},
+	{"wmemchr", check_wmemchr},
+	{"wcscmp", check_wcscmp},
+	{"wmemset", check_wmemset},
+	{"wmemcpy", check_wmemcpy},
+};
+
+//---------------------------------------------------------------------------------------
+// Benchmark.
+//---------------------------------------------------------------------------------------
+
+constexpr size_t max_bench_length = 1 << 20;
+
+unsigned char *bench_x;
+unsigned char *bench_y;
+wchar_t *bench_wx;
+wchar_t *bench_wy;
+
+template<typename T>
+void sink(T value) {
+	asm volatile ("" : : "g"(value) : "memory");
+}
+
+// Prepares equal strings of length n that do not contain 'z'.
+void prepare_bench(size_t n) {
+	for(size_t i = 0; i < n; i++) {
+		bench_x[i] = 'a';
+		bench_y[i] = 'a';
+		bench_wx[i] = L'a';
+		bench_wy[i] = L'a';
+	}
+	bench_x[n] = 0;
+	bench_y[n] = 0;
+	bench_wx[n] = 0;
+	bench_wy[n] = 0;
+}
+
+uint64_t now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+}
+
+double nanoseconds_per_call(void (*call)(size_t), size_t n) {
+	for(size_t iterations = 1; ; iterations *= 2) {
+		auto start = now();
+		for(size_t i = 0; i < iterations; i++)
+			call(n);
+		auto elapsed = now() - start;
+		if(elapsed >= 5'000'000)
+			return double(elapsed) / iterations;
+	}
+}
+
+#define X reinterpret_cast<char *>(bench_x)
+#define Y reinterpret_cast<char *>(bench_y)
+
+// Each benchmark calls mlibc's and the host's function with the same arguments.
+#define BENCH(name, element, ...) {#name, element, \
+		[] (size_t n) { (void)n; sink(mlibc_##name(__VA_ARGS__)); }, \
+		[] (size_t n) { (void)n; sink(name(__VA_ARGS__)); }}
+
+struct {
+	const char *name;
+	size_t element_size;
+	void (*mlibc)(size_t);
+	void (*host)(size_t);
+} benchmarks[] = {
+	BENCH(memcpy, 1, bench_y, bench_x, n),
+	BENCH(memmove, 1, bench_y + 1, bench_y, n),
+	BENCH(memset, 1, bench_y, 'a', n),
+	BENCH(memcmp, 1, bench_x, bench_y, n),
+	BENCH(memchr, 1, bench_x, 'z', n),
+	BENCH(memrchr, 1, bench_x, 'z', n),
+	BENCH(strlen, 1, X),
+	BENCH(strnlen, 1, X, n),
+	BENCH(strchr, 1, X, 'z'),
+	BENCH(strrchr, 1, X, 'z'),
+	BENCH(strcmp, 1, X, Y),
+	BENCH(strncmp, 1, X, Y, n),
+	BENCH(strcasecmp, 1, X, Y),
+	BENCH(strcpy, 1, Y, X),
+	BENCH(strspn, 1, X, "ab"),
+	BENCH(strcspn, 1, X, "yz"),
+	BENCH(strstr, 1, X, "aaab"),
+	BENCH(memmem, 1, bench_x, n, "aaab", 4),
+	BENCH(wcslen, sizeof(wchar_t), bench_wx),
+	BENCH(wcschr, sizeof(wchar_t), bench_wx, L'z'),
+	BENCH(wcscmp, sizeof(wchar_t), bench_wx, bench_wy),
+	BENCH(wmemset, sizeof(wchar_t), bench_wy, L'a', n),
+};
+
+#undef BENCH
+#undef X
+#undef Y
+
+void run_benchmarks(const char *filter) {
+	guarded_buffer x{(max_bench_length + 1) * sizeof(wchar_t)};
+	guarded_buffer y{(max_bench_length + 1) * sizeof(wchar_t)};
+	guarded_buffer wx{(max_bench_length + 1) * sizeof(wchar_t)};
+	guarded_buffer wy{(max_bench_length + 1) * sizeof(wchar_t)};
+	bench_x = x.base;
+	bench_y = y.base;
+	bench_wx = reinterpret_cast<wchar_t *>(wx.base);
+	bench_wy = reinterpret_cast<wchar_t *>(wy.base);
+
+	printf("%-12s %9s %12s %10s %12s %10s\n", "function", "length",
+			"mlibc ns", "mlibc GB/s", "host ns", "host GB/s");
+	for(auto &bench : benchmarks) {
+		if(filter && strcmp(filter, bench.name))
+			continue;
+		for(size_t n = 1; n <= max_bench_length; n *= 4) {
+			// Also measure lengths that are not powers of two.
+			size_t lengths[] = {n, n + n / 2 + 1};
+			for(size_t length : lengths) {
+				if(length > max_bench_length)
+					continue;
+				prepare_bench(length);
+				double t_mlibc = nanoseconds_per_call(bench.mlibc, length);
+				prepare_bench(length);
+				double t_host = nanoseconds_per_call(bench.host, length);
+				double bytes = double(length * bench.element_size);
+				printf("%-12s %9zu %12.1f %10.2f %12.1f %10.2f\n", bench.name, length,
+						t_mlibc, bytes / t_mlibc, t_host, bytes / t_host);
+			}
+		}
+	}
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+	const char *filter = nullptr;
+	bool bench = false;
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "--bench")) {
+			bench = true;
+		}else{
+			filter = argv[i];
+		}
+	}
+
+	if(bench) {
+		run_benchmarks(filter);
+		return 0;
+	}
+
+	for(auto &test : tests) {
+		if(filter && strcmp(filter, test.name))
+			continue;
+		current_function = test.name;
+		auto before = num_failures;
+		sweep(test.check);
+		printf("%-12s %s\n", test.name, num_failures == before ? "ok" : "FAILED");
+	}
+	if(num_failures) {
+		fprintf(stderr, "string-kernels: %lu checks failed\n", num_failures);
+		return 1;
+	}
+	return 0;
+}
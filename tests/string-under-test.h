@@ -0,0 +1,86 @@
+#ifndef MLIBC_TESTS_STRING_UNDER_TEST_H
+#define MLIBC_TESTS_STRING_UNDER_TEST_H
+
+// This header is force-included into the libc sources that string-kernels links against.
+// It gives every function that these sources define an mlibc_ prefix, so that they
+// can be linked into a host program without replacing the functions of the host libc.
+
+// string.h and its POSIX, GNU and BSD extensions.
+#define memchr mlibc_memchr
+#define memcmp mlibc_memcmp
+#define memcpy mlibc_memcpy
+#define memmem mlibc_memmem
+#define memmove mlibc_memmove
+#define mempcpy mlibc_mempcpy
+#define memrchr mlibc_memrchr
+#define memset mlibc_memset
+#define rawmemchr mlibc_rawmemchr
+#define stpcpy mlibc_stpcpy
+#define stpncpy mlibc_stpncpy
+#define strcasestr mlibc_strcasestr
+#define strcat mlibc_strcat
+#define strchr mlibc_strchr
+#define strchrnul mlibc_strchrnul
+#define strcmp mlibc_strcmp
+#define strcoll mlibc_strcoll
+#define strcpy mlibc_strcpy
+#define strcspn mlibc_strcspn
+#define strdup mlibc_strdup
+#define strerror mlibc_strerror
+#define strerror_r mlibc_strerror_r
+#define strlcat mlibc_strlcat
+#define strlcpy mlibc_strlcpy
+#define strlen mlibc_strlen
+#define strncat mlibc_strncat
+#define strncmp mlibc_strncmp
+#define strncpy mlibc_strncpy
+#define strndup mlibc_strndup
+#define strnlen mlibc_strnlen
+#define strpbrk mlibc_strpbrk
+#define strrchr mlibc_strrchr
+#define strsep mlibc_strsep
+#define strsignal mlibc_strsignal
+#define strspn mlibc_strspn
+#define strstr mlibc_strstr
+#define strtok mlibc_strtok
+#define strtok_r mlibc_strtok_r
+#define strxfrm mlibc_strxfrm
+
+// strings.h.
+#define bcmp mlibc_bcmp
+#define ffs mlibc_ffs
+#define strcasecmp mlibc_strcasecmp
+#define strncasecmp mlibc_strncasecmp
+
+// The wchar.h functions that string-stubs.cpp defines.
+#define wcscat mlibc_wcscat
+#define wcschr mlibc_wcschr
+#define wcscmp mlibc_wcscmp
+#define wcscoll mlibc_wcscoll
+#define wcscpy mlibc_wcscpy
+#define wcscspn mlibc_wcscspn
+#define wcslen mlibc_wcslen
+#define wcsncat mlibc_wcsncat
+#define wcsncmp mlibc_wcsncmp
+#define wcsncpy mlibc_wcsncpy
+#define wcsnlen mlibc_wcsnlen
+#define wcspbrk mlibc_wcspbrk
+#define wcsrchr mlibc_wcsrchr
+#define wcsspn mlibc_wcsspn
+#define wcsstr mlibc_wcsstr
+#define wcstod mlibc_wcstod
+#define wcstof mlibc_wcstof
+#define wcstok mlibc_wcstok
+#define wcstol mlibc_wcstol
+#define wcstold mlibc_wcstold
+#define wcstoll mlibc_wcstoll
+#define wcstoul mlibc_wcstoul
+#define wcstoull mlibc_wcstoull
+#define wcsxfrm mlibc_wcsxfrm
+#define wmemchr mlibc_wmemchr
+#define wmemcmp mlibc_wmemcmp
+#define wmemcpy mlibc_wmemcpy
+#define wmemmove mlibc_wmemmove
+#define wmemset mlibc_wmemset
+
+#endif // MLIBC_TESTS_STRING_UNDER_TEST_H